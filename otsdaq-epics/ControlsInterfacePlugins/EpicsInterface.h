@@ -1,24 +1,46 @@
 #ifndef _ots_EpicsInterface_h
 #define _ots_EpicsInterface_h
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <condition_variable>
 #include <ctime>
+#include <deque>
 #include <fstream>
+#include <functional>
+#include <future>
+#include <list>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <queue>
+#include <shared_mutex>
+#include <string_view>
 #include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 #include "cadef.h"
 
 #include <arpa/inet.h>
 #include <dirent.h>
+#include <endian.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <string>
@@ -35,70 +57,678 @@ struct dbr_ctrl_char;
 namespace ots
 {
 class EpicsInterface;
+struct PVInfo;
 
+// Passed to CA as both the channel puser and the subscription usr argument,
+//	so callbacks reach their PVInfo in O(1) without a name lookup.
 struct PVHandlerParameters
 {
-	PVHandlerParameters(std::string pv, EpicsInterface* client)
+	PVHandlerParameters(const std::string& pv, EpicsInterface* client, PVInfo* info)
 	{
 		pvName    = pv;
 		webClient = client;
+		pvInfo    = info;
 	}
 	std::string     pvName;
 	EpicsInterface* webClient;
+	PVInfo*         pvInfo;
 };
 
+// One alarm status/severity transition, kept as the EPICS enum values
+//	(epicsAlarmCondition/epicsAlarmSeverity) rather than strings.
 struct PVAlerts
 {
-	PVAlerts(time_t t, const char* c, const char* d)
+	PVAlerts() = default;
+	PVAlerts(const epicsTimeStamp& t, short c, short d)
 	{
-		status   = c;
-		severity = d;
-		time     = t;
+		stamp    = t;
+		status   = (unsigned char)c;
+		severity = (unsigned char)d;
 	}
-	std::string status;
-	std::string severity;
-	time_t      time;
+	const char* statusToString(void) const;
+	const char* severityToString(void) const;
+
+	epicsTimeStamp stamp    = {0, 0};  // IOC time of the transition
+	unsigned char  status   = 0;
+	unsigned char  severity = 0;
 };
 
-struct PVInfo
+// One monitor update, kept in native binary form.
+//	The value is only formatted into a string when a getter asks for it.
+struct PVSample
 {
-	PVInfo(chtype tmpChannelType)
+	enum class ValueType : unsigned char
 	{
-		channelType = tmpChannelType;
-		dataCache.resize(circularBufferSize);
-		for(int i = 0; i < circularBufferSize; i++)
+		EMPTY,
+		DOUBLE,
+		LONG,
+		ENUM,
+		STRING
+	};
+
+	PVSample() : doubleValue(0) {}
+
+	void        setValue(long dbrType, const void* value);
+	void        setTime(const epicsTimeStamp& iocStamp);
+	long long   timeNs(void) const;  // POSIX time in nanoseconds
+	std::string timeToString(void) const;
+	std::string valueToString(void) const;
+	bool        valueToDouble(double& value) const;  // false for strings and empty samples
+	bool        sameValue(const PVSample& other) const;  // same type and value, bitwise for doubles
+
+	epicsTimeStamp stamp = {0, 0};  // IOC timestamp, EPICS epoch
+	ValueType      type  = ValueType::EMPTY;
+	union
+	{
+		double         doubleValue;
+		long           longValue;
+		unsigned short enumValue;
+		char           stringValue[MAX_STRING_SIZE];
+	};
+};
+
+// Latest payload of an array (waveform) PV.
+//	The buffer is filled once from the CA callback and then shared with readers
+//	by reference count; it goes back to its WaveformPool when the last view drops.
+struct PVWaveform
+{
+	std::string elementToString(unsigned long index) const;
+	std::string toString(void) const;
+
+	long              dbrType     = DBR_DOUBLE;  // plain DBR_* element type
+	unsigned long     count       = 0;           // valid elements in data
+	size_t            elementSize = 0;
+	epicsTimeStamp    stamp       = {0, 0};
+	std::vector<char> data;  // preallocated to the channel's native element count
+};
+
+// Fixed size block of numeric samples, compressed as in Facebook's Gorilla TSDB:
+//	delta-of-delta timestamps and XOR'd doubles, a few bytes per sample for slowly
+//	changing PVs. The alarm state is only stored when it changes.
+class HistoryChunk
+{
+  public:
+	static constexpr size_t BYTES = 1024;
+
+	bool         append(long long timeNs, double value, short status, short severity);  // false once full
+	void         forEach(const std::function<void(long long timeNs, double value, short status, short severity)>& f) const;  // oldest first
+	long long    firstNs(void) const { return firstNs_; }
+	long long    lastNs(void) const { return lastNs_; }
+	unsigned int count(void) const { return count_; }
+
+  private:
+	static constexpr size_t MAX_SAMPLE_BITS = 4 + 64 + 2 + 12 + 64 + 1 + 16;
+
+	void writeBits(uint64_t value, unsigned int bits);
+
+	uint64_t      words_[BYTES / sizeof(uint64_t)] = {};
+	size_t        bitPos_                          = 0;
+	unsigned int  count_                           = 0;
+	long long     firstNs_ = 0, lastNs_ = 0, lastDelta_ = 0;
+	uint64_t      lastValue_    = 0;
+	unsigned int  lastLeading_  = 64;  // 64 = no XOR window yet
+	unsigned int  lastTrailing_ = 0;
+	unsigned char status_ = 0, severity_ = 0;
+};
+
+// In-memory history of one PV in a time window: the ring entries and the raw
+//	compressed chunks are copied out under its historyMutex, so that decoding and
+//	formatting run without holding the lock the CA callback needs for every update.
+struct MemoryHistory
+{
+	struct Sample
+	{
+		long long       timeNs;
+		double          value;     // if hasValue
+		bool            hasValue;  // numeric
+		short           status, severity;
+		const PVSample* raw;  // ring entry, nullptr if decoded from a chunk
+	};
+
+	bool forEach(const std::function<bool(const Sample& sample)>& onSample) const;  // newest first, false if onSample stopped it
+
+	std::vector<struct PVSnapshot> ring;                     // inside the window, oldest first
+	std::vector<HistoryChunk>      chunks;                   // overlapping the window behind the ring, oldest first
+	long long                      chunksFromNs = LLONG_MAX;  // chunk samples in [chunksFromNs, chunksToNs) belong to the window
+	long long                      chunksToNs   = LLONG_MAX;
+};
+
+// Preallocated buffers for one waveform PV, recycled instead of freed
+class WaveformPool : public std::enable_shared_from_this<WaveformPool>
+{
+  public:
+	WaveformPool(size_t bufferBytes, unsigned int preallocate);
+
+	std::shared_ptr<PVWaveform> acquire(void);  // falls back to allocating if all buffers are in use
+	size_t                      bufferBytes(void) const { return bufferBytes_; }
+
+  private:
+	void release(PVWaveform* buffer);
+
+	const size_t                             bufferBytes_;
+	std::mutex                               mutex_;
+	std::vector<std::unique_ptr<PVWaveform>> free_;
+};
+
+// Latest value and alarm state of a PV, published as one unit.
+//	status/severity are the EPICS alarm condition/severity codes, -1 until known.
+struct PVSnapshot
+{
+	PVSample sample;
+	short    status   = -1;
+	short    severity = -1;
+};
+
+// Single-writer sequence lock.
+//	The CA callback thread of the PV's circuit is the only writer; readers never
+//	block it and retry if they overlap a write. The payload is copied through
+//	relaxed atomic words so concurrent access stays well-defined.
+template<class T>
+class SeqLock
+{
+  public:
+	SeqLock()
+	{
+		for(auto& word : words_)
+			word.store(0, std::memory_order_relaxed);
+		store(T());
+	}
+
+	void store(const T& value)
+	{
+		uint64_t buffer[WORD_COUNT] = {};
+		memcpy(buffer, &value, sizeof(T));
+
+		unsigned int seq = sequence_.load(std::memory_order_relaxed);
+		sequence_.store(seq + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		for(size_t i = 0; i < WORD_COUNT; ++i)
+			words_[i].store(buffer[i], std::memory_order_relaxed);
+		sequence_.store(seq + 2, std::memory_order_release);
+	}
+
+	T load(void) const
+	{
+		uint64_t     buffer[WORD_COUNT];
+		unsigned int seqBefore, seqAfter;
+		do
+		{
+			seqBefore = sequence_.load(std::memory_order_acquire);
+			for(size_t i = 0; i < WORD_COUNT; ++i)
+				buffer[i] = words_[i].load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			seqAfter = sequence_.load(std::memory_order_relaxed);
+		} while((seqBefore & 1) || seqBefore != seqAfter);
+
+		T value;
+		memcpy(&value, buffer, sizeof(T));
+		return value;
+	}
+
+  private:
+	static constexpr size_t WORD_COUNT = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+	std::atomic<unsigned int> sequence_{0};
+	std::atomic<uint64_t>     words_[WORD_COUNT];
+};
+
+// Link of a PV in the AlarmEventQueue, embedded in PVInfo so posting never allocates
+struct AlarmEventNode
+{
+	std::atomic<AlarmEventNode*> next{nullptr};
+	std::atomic<bool>            queued{false};  // at most one pending event per PV
+	PVInfo*                      pvInfo = nullptr;
+};
+
+// Intrusive multi-producer single-consumer queue (Vyukov). push() is wait-free
+//	(one exchange and one store), so the CA callback threads never block on it;
+//	pop() and drained() may only be called by the one consumer thread.
+class AlarmEventQueue
+{
+  public:
+	AlarmEventQueue() : head_(&stub_), tail_(&stub_) {}
+
+	// false if the node is already queued
+	bool push(AlarmEventNode* node)
+	{
+		if(node->queued.exchange(true, std::memory_order_acq_rel))
+			return false;
+		link(node);
+		return true;
+	}
+
+	// nullptr if empty, or if a producer is between its exchange and its store
+	AlarmEventNode* pop(void)
+	{
+		AlarmEventNode* tail = tail_;
+		AlarmEventNode* next = tail->next.load(std::memory_order_acquire);
+		if(tail == &stub_)
+		{
+			if(!next)
+				return nullptr;
+			tail_ = next;
+			tail  = next;
+			next  = next->next.load(std::memory_order_acquire);
+		}
+		if(next)
 		{
-			std::pair<time_t, std::string> filler(0, "");
-			dataCache[i] = filler;
+			tail_ = next;
+			return tail;
 		}
-		// mostRecentBufferIndex = 0;
+		if(tail != head_.load(std::memory_order_acquire))
+			return nullptr;
+		link(&stub_);  // so the last node can be handed out
+		next = tail->next.load(std::memory_order_acquire);
+		if(!next)
+			return nullptr;
+		tail_ = next;
+		return tail;
+	}
+
+	bool drained(void) const { return tail_ == &stub_ && head_.load(std::memory_order_acquire) == &stub_; }
+
+	// forget all nodes, only once no producer or consumer is left
+	void reset(void)
+	{
+		stub_.next.store(nullptr, std::memory_order_relaxed);
+		head_.store(&stub_, std::memory_order_relaxed);
+		tail_ = &stub_;
+	}
+
+  private:
+	void link(AlarmEventNode* node)
+	{
+		node->next.store(nullptr, std::memory_order_relaxed);
+		AlarmEventNode* prev = head_.exchange(node, std::memory_order_acq_rel);
+		prev->next.store(node, std::memory_order_release);
+	}
+
+	std::atomic<AlarmEventNode*> head_;  // last pushed
+	AlarmEventNode*              tail_;  // next to pop, consumer only
+	AlarmEventNode               stub_;
+};
+
+// Archiver catalog entry of a PV, filled by loadListOfPVs() or from the snapshot.
+//	Never modified once published: a reload swaps in a new one, so web threads
+//	never read a string while the reconcile thread assigns it.
+struct PVCatalog
+{
+	int         archiverChannelID = -1;
+	int         smplModeID        = 0;   // 2 = periodic sampling at smplPer
+	std::string smplPer;                 // as returned by the archiver, "" if unknown
+	std::string unit;                    // from num_metadata, "" for non numeric channels
+	int         prec              = -1;
+};
+
+struct PVInfo
+{
+	PVInfo(const std::string& tmpPVName, chtype tmpChannelType, unsigned int historyDepth = 10)
+	{
+		pvName             = tmpPVName;
+		channelType        = tmpChannelType;
+		circularBufferSize = historyDepth ? historyDepth : 1;
+		dataCache.resize(circularBufferSize);
+		alarmEvent.pvInfo  = this;
+	}
+
+	const PVSnapshot& historyAt(unsigned int i) const  // i = 0 is the oldest sample held; caller holds historyMutex
+	{
+		return dataCache[(historyHead + circularBufferSize - historySize + i) % circularBufferSize];
+	}
+
+	// start of the continuous part of compressedHistory, LLONG_MAX if none;
+	//	never before the first sample still held; caller holds historyMutex
+	long long compressedCoverageNs(void) const
+	{
+		if(compressedFromNs == LLONG_MAX || compressedHistory.empty())
+			return LLONG_MAX;
+		return std::max(compressedFromNs, compressedHistory.front()->firstNs());
 	}
 
-	chid                 channelID    = NULL;
+	const PVAlerts& alertAt(unsigned int i) const  // i = 0 is the oldest transition held; caller holds alertsMutex
+	{
+		return alerts[(alertsHead + ALERTS_CAPACITY - alertsSize + i) % ALERTS_CAPACITY];
+	}
+
+	chid getChannel(void)  // channelID for threads other than the CA callbacks
+	{
+		std::lock_guard<std::mutex> lock(channelMutex);
+		return channelID;
+	}
+
+	std::string          pvName;  // interned name, keys of mapOfPVInfo_ view into it
+	chid                 channelID    = NULL;  // written under channelMutex; CA sets it before any callback of the channel runs
+	std::mutex           channelMutex;         // so a channel is created once; never taken in CA callbacks (ca_clear_channel waits for them)
 	PVHandlerParameters* parameterPtr = NULL;
-	evid                 eventID      = NULL;
+	evid                 eventID      = NULL;  // DBR_TIME value/alarm monitor
+	evid                 ctrlEventID  = NULL;  // DBR_CTRL property monitor
+	std::atomic<unsigned long> elementCount{1};  // native element count, > 1 for waveforms; set by the connection callback and subscribeToChannel()
+	std::atomic<bool>    subscribeOnConnect{false};  // monitors are created from the CA_OP_CONN_UP callback
+	std::atomic<bool>    subscribed{false};  // claimed by the one subscribeToChannel() call that creates eventID/ctrlEventID
+	bool                 connected = false;  // only touched by the CA connection callback
 	chtype               channelType;
 	std::string          pvValue;
-	int                  circularBufferSize    = 10;  // Default Guess
-	unsigned int         mostRecentBufferIndex = -1;
-	std::vector<std::pair<time_t, std::string>>
-	     dataCache;           // (10, std::pair<time_t, std::string> (0, ""));
+
+	std::shared_ptr<const PVCatalog> loadCatalog(void) const { return std::atomic_load(&catalog); }
+	void                             storeCatalog(std::shared_ptr<const PVCatalog> newCatalog) { std::atomic_store(&catalog, std::move(newCatalog)); }
+	std::shared_ptr<const PVCatalog> catalog = std::make_shared<const PVCatalog>();  // only through loadCatalog()/storeCatalog()
+
+	unsigned int            circularBufferSize = 10;  // per-PV depth, see EpicsInterface::getHistoryDepth()
+	unsigned int            historyHead        = 0;   // next slot to write
+	unsigned int            historySize        = 0;   // valid samples, oldest first in time order
+	std::vector<PVSnapshot> dataCache;                // circular buffer of typed samples, guarded by historyMutex
+	std::mutex              historyMutex;
+	std::deque<std::unique_ptr<HistoryChunk>> compressedHistory;  // older samples, oldest chunk first, guarded by historyMutex
+	long long               compressedFromNs = LLONG_MAX;  // compressedHistory is continuous from here, LLONG_MAX after a disconnect until the next sample
 	bool valueChange = true;  // so that it automatically reports the status when
 	                          // we open the viewer for the first time - get to see
 	                          // what is DC'd
-	std::queue<PVAlerts> alerts;
+	static constexpr unsigned int ALERTS_CAPACITY = 16;
+	std::array<PVAlerts, ALERTS_CAPACITY> alerts;  // last alarm transitions, oldest overwritten first, guarded by alertsMutex
+	unsigned int                          alertsHead = 0;  // next slot to write
+	unsigned int                          alertsSize = 0;
+	std::mutex                            alertsMutex;
+	PVSnapshot           latest;    // writer-side copy, only touched by the CA callback thread
+	SeqLock<PVSnapshot>  snapshot;  // what readers on other threads see
+
+	std::shared_ptr<WaveformPool>     waveformPool;   // only for array PVs
+	std::shared_ptr<const PVWaveform> waveform;       // latest array payload, guarded by waveformMutex
+	std::mutex                        waveformMutex;  // held only to swap/copy the pointer
+	std::atomic<bool>                 alarmWatched{false};  // listed in the alarm notifications, see EpicsInterface::compileAlarmWatches()
+	std::vector<unsigned int>         alarmWatches;         // into EpicsInterface::alarmWatches_, guarded by alarmWatchMutex_
+	AlarmEventNode                    alarmEvent;           // posted by the CA callback on alarm transitions
 	//struct dbr_ctrl_char settings;
-	struct dbr_ctrl_double settings;
+	SeqLock<dbr_ctrl_double> settings;  // written by the DBE_PROPERTY monitor (or loadSnapshot() before it), read by any thread
 
 };
 
 //db connection
-PGconn *dcsArchiveDbConn;
-PGconn *dcsAlarmDbConn;
-PGconn *dcsLogDbConn;
-int dcsArchiveDbConnStatus_;
-int dcsAlarmDbConnStatus_;
-int dcsLogDbConnStatus_;
+
+// Owns a PGresult and clears it when going out of scope
+using PGResultPtr = std::unique_ptr<PGresult, decltype(&PQclear)>;
+
+// Prepared statements of one db connection. Each statement is parsed and
+//	planned once, on first use, instead of on every call; parameters are sent
+//	separately so names are neither quoted nor truncated.
+class PreparedStatements
+{
+  public:
+	PGResultPtr exec(PGconn* conn, const char* name, const char* sql, const std::vector<std::string>& params, int resultFormat = 0);
+	bool        send(PGconn* conn, const char* name, const char* sql, const std::vector<std::string>& params, int resultFormat = 0);  // async, results via PQgetResult
+	void        reset(void) { prepared_.clear(); }  // after (re)connecting
+
+  private:
+	PGResultPtr prepare(PGconn* conn, const char* name, const char* sql, int nParams);  // nullptr once prepared
+	std::unordered_set<std::string> prepared_;
+};
+
+// Connections to one database, shared by concurrent requests; a libpq connection must
+//	only be used by one thread at a time. checkout() hands out an idle connection, opens
+//	another one while below the pool size, or waits up to the checkout timeout for one
+//	to come back. The Lease returns the connection when it goes out of scope. Connections
+//	idle for a while are checked with a trivial query before reuse.
+//	A failed login or a connection lost during a query marks the database down: checkout()
+//	then fails at once and a background thread reconnects with exponential backoff,
+//	connecting non-blocking so no caller ever waits for a TCP timeout.
+class PGConnectionPool
+{
+  public:
+	static constexpr int HEALTH_CHECK_IDLE_SECONDS = 30;
+	static constexpr int CONNECT_TIMEOUT_SECONDS   = 10;  // default per connect attempt
+	static constexpr int RECONNECT_BACKOFF_MAX_S   = 60;  // 1, 2, 4, ... seconds up to this
+
+	struct Connection
+	{
+		~Connection(void)
+		{
+			if(conn)
+				PQfinish(conn);
+		}
+		PGconn*                               conn = nullptr;
+		PreparedStatements                    statements;  // prepared on this connection
+		std::chrono::steady_clock::time_point lastUsed;
+		unsigned int                          generation = 0;  // of the pool when opened, stale after close()
+	};
+
+	class Lease
+	{
+	  public:
+		Lease(void) = default;
+		Lease(PGConnectionPool* pool, std::unique_ptr<Connection>&& connection) : pool_(pool), connection_(std::move(connection)) {}
+		Lease(Lease&& other) = default;
+		Lease& operator=(Lease&& other);
+		~Lease(void) { release(); }
+
+		explicit operator bool(void) const { return connection_ != nullptr; }
+		PGconn*             conn(void) const { return connection_->conn; }
+		PreparedStatements& statements(void) const { return connection_->statements; }
+		unsigned int        generation(void) const { return connection_->generation; }
+		void                release(void);  // back to the pool before going out of scope
+
+	  private:
+		PGConnectionPool*           pool_ = nullptr;
+		std::unique_ptr<Connection> connection_;
+	};
+
+	~PGConnectionPool(void) { close(); }
+
+	bool  open(const std::string& name,
+	           const std::string& connInfo,
+	           unsigned int       size,
+	           unsigned int       checkoutTimeoutMs,
+	           unsigned int       connectTimeoutMs = CONNECT_TIMEOUT_SECONDS * 1000);  // false if the db cannot be reached
+	void  close(void);
+	Lease checkout(void);  // empty if the db is down or no connection came back in time
+	bool  connected(void) const { return connected_; }
+
+  private:
+	std::unique_ptr<Connection> connect(std::chrono::milliseconds timeout);  // nullptr if it fails; called without mutex_
+	bool                        ping(PGconn* conn, std::chrono::milliseconds timeout);  // false if no answer in time; called without mutex_
+	void                        giveBack(std::unique_ptr<Connection>&& connection);
+	void                        markDown(const std::string& reason);  // called without mutex_
+	void                        reconnectLoop(void);
+
+	std::string                              name_;
+	std::string                              connInfo_;
+	unsigned int                             size_ = 1;
+	std::chrono::milliseconds                checkoutTimeout_{5000};
+	std::chrono::milliseconds                connectTimeout_{CONNECT_TIMEOUT_SECONDS * 1000};
+	std::mutex                               mutex_;
+	std::condition_variable                  available_;
+	std::vector<std::unique_ptr<Connection>> idle_;  // most recently used last
+	unsigned int                             open_       = 0;  // idle, leased or being opened
+	unsigned int                             generation_ = 0;
+	std::atomic<bool>                        connected_{false};
+	std::thread                              reconnectThread_;
+	std::condition_variable                  reconnectCV_;
+	bool                                     reconnecting_  = false;  // guarded by mutex_
+	bool                                     stopReconnect_ = false;  // guarded by mutex_
+};
+
+// Sends many independent statements without waiting for each reply (libpq pipeline
+//	mode) and collects the outcome per tag. The statements of one tag are queued one
+//	after the other and run as one implicit transaction: if one fails the server skips
+//	the rest of that tag, other tags are unaffected. Replies are read back every
+//	WINDOW tags, so neither side's socket buffer fills up. Built against a libpq
+//	without pipelining, each tag runs as BEGIN ... COMMIT with one round trip per statement.
+class PGPipeline
+{
+  public:
+	static constexpr size_t WINDOW = 256;
+
+	explicit PGPipeline(PGconn* conn) : conn_(conn) {}
+
+	void                                             queue(const std::string& tag, const char* sql, std::vector<std::string>&& params);
+	std::vector<std::pair<std::string, std::string>> run(void);  // (tag, error) of every tag that failed, in queue order
+
+  private:
+	struct Statement
+	{
+		std::string              tag;
+		const char*              sql;
+		std::vector<std::string> params;
+	};
+
+	bool        send(const Statement& statement);
+	std::string exec(const char* sql, const std::vector<std::string>& params);  // "" or the error
+
+	PGconn*                conn_;
+	std::vector<Statement> statements_;
+};
+
+// One archiver sample as decoded from the binary history query
+struct ArchiveSample
+{
+	long long   seconds  = 0;  // POSIX
+	long long   nanosecs = 0;
+	bool        hasValue = false;  // float_val is NULL for non numeric samples
+	double      value    = 0;
+	std::string status;
+	std::string severity;
+	bool        hasSmplPer = false;
+	double      smplPer    = 0;
+
+	long long timeNs(void) const { return seconds * 1000000000LL + nanosecs; }
+};
+
+// Archiver rows already fetched, per PV and interval of whole seconds, so that
+//	overlapping trend requests only query what was not fetched before. Overlapping and
+//	adjacent intervals are merged; whole intervals are dropped least recently used first
+//	once over the byte budget. Samples are shared, so a reader keeps the rows it looked
+//	up even if the interval is evicted meanwhile.
+class ArchiveHistoryCache
+{
+  public:
+	static constexpr int SETTLE_SECONDS = 120;  // newer rows may still be on their way into the archive, never cached
+
+	using Samples = std::shared_ptr<const std::vector<ArchiveSample>>;  // newest first
+	struct Piece
+	{
+		int     fromS, toS;
+		Samples samples;  // nullptr if [fromS, toS) is not cached
+	};
+	struct Stats
+	{
+		unsigned long long hits = 0, partialHits = 0, misses = 0;  // lookups fully, partly and not at all in cache
+		unsigned long long rowsFromCache = 0, rowsFromArchive = 0;
+		unsigned long long evictions = 0;
+		size_t             bytes     = 0;
+	};
+
+	void               setBudget(size_t bytes);
+	size_t             budget(void) const { return budget_; }
+	std::vector<Piece> lookup(const std::string& pvName, int fromS, int toS);  // pieces covering [fromS, toS), newest first
+	void               insert(const std::string& pvName, int fromS, int toS, std::vector<ArchiveSample>&& samples);  // samples newest first
+	void               countRows(size_t fromCache, size_t fromArchive);
+	void               clear(void);
+	Stats              stats(void) const;
+
+  private:
+	using LRU = std::list<std::pair<std::string, int>>;  // (pvName, fromS), most recently used first
+	struct Segment
+	{
+		int           toS;
+		Samples       samples;
+		size_t        bytes;
+		LRU::iterator lru;
+	};
+
+	void evict(void);  // caller holds mutex_
+
+	mutable std::mutex                                       mutex_;
+	std::atomic<size_t>                                      budget_{0};
+	std::unordered_map<std::string, std::map<int, Segment>> segments_;  // per PV, keyed by fromS, disjoint
+	LRU                                                      lru_;
+	Stats                                                    stats_;
+};
+
+// Archiver settings of one channel as configure() writes them to channel and num_metadata
+struct ArchiveChannelConfig
+{
+	std::string name;
+	std::string descr;
+	int         grpID      = 4;
+	int         smplModeID = 1;
+	double      smplVal    = 0.;
+	double      smplPer    = 60.;
+	int         retentID   = 9999;
+	double      retentVal  = 9999.;
+
+	double      lowDispRng   = 0.;
+	double      highDispRng  = 0.;
+	double      lowWarnLmt   = 0.;
+	double      highWarnLmt  = 0.;
+	double      lowAlarmLmt  = 0.;
+	double      highAlarmLmt = 0.;
+	int         prec         = 0;
+	std::string unit;
+
+	uint64_t fingerprint(void) const;  // of everything but the name, to tell which channels changed
+};
+
+// Reduces a time window to a fixed number of equal width buckets, each keeping
+//	min/max/mean/last. Samples can be added one by one or whole buckets merged in,
+//	e.g. ones already aggregated by the archiver.
+class HistoryDownsampler
+{
+  public:
+	struct Bucket
+	{
+		unsigned long long count = 0;
+		double             min = 0, max = 0, sum = 0;
+		double             last   = 0;
+		long long          lastNs = LLONG_MIN;
+	};
+
+	static constexpr unsigned int MAX_BUCKETS = 100000;  // far more than any plot has pixels
+
+	HistoryDownsampler(long long startNs, long long endNs, unsigned int buckets);
+
+	void add(long long timeNs, double value) { merge(bucketOf(timeNs), value, value, value, 1, value, timeNs); }
+	void merge(long long bucket, double min, double max, double sum, unsigned long long count, double last, long long lastNs);
+	long long                            bucketOf(long long timeNs) const;  // -1 if outside the window
+	long long                            bucketStartNs(unsigned int bucket) const;
+	std::vector<std::vector<std::string>> toRows(void) const;  // newest first, {time, min, max, mean, last, count}
+
+  private:
+	long long           startNs_;
+	long long           endNs_;
+	std::vector<Bucket> buckets_;
+};
+
+// One group of LinkToAlarmAlertNotificationsTable
+struct AlarmWatchGroup
+{
+	std::string name;
+	std::string whoToNotify;
+	std::string doSendEmail;
+};
+
+// One alarm of a notification group, resolved to its PV when compiled
+struct AlarmWatch
+{
+	PVInfo*      pvInfo;
+	bool         ignoreMinor;
+	std::string  alarmName;
+	unsigned int group;                   // into alarmWatchGroups_
+	size_t       activeSlot = SIZE_MAX;   // position in activeAlarmWatches_, SIZE_MAX while not in alarm
+};
+
+// One alarm of a LinkTo<Transition>AlarmsToMonitorTable, resolved to its PV when compiled
+struct FSMAlarm
+{
+	PVInfo*     pvInfo;
+	bool        ignoreMinor;
+};
+
+// Alarms checked by one FSM transition (or by running)
+struct FSMAlarmSet
+{
+	bool                     disconnected = true;
+	std::vector<std::string> alarmNames;       // all records in configuration order, for the report
+	std::vector<FSMAlarm>    alarms;
+	std::vector<std::string> missingChannels;  // AlarmChannelName of records whose PV is not in the map
+};
 
 class EpicsInterface : public SlowControlsVInterface
 {
@@ -126,43 +756,94 @@ class EpicsInterface : public SlowControlsVInterface
 	std::array<std::string, 4> 				getCurrentValue			(const std::string& pvName) override;
 	std::array<std::string, 9> 				getSettings				(const std::string& pvName) override;
 	std::vector<std::vector<std::string>> 	getChannelHistory		(const std::string& pvName, int startTime, int endTime) override;
+	std::vector<std::vector<std::string>>	getChannelHistoryDownsampled(const std::string& pvName, int startTime, int endTime, unsigned int maxPoints);
+	ArchiveHistoryCache::Stats				getHistoryCacheStats	(void) const;
+	bool 									streamChannelHistory	(const std::string& pvName, int startTime, int endTime, const std::function<bool(std::vector<std::vector<std::string>>& chunk)>& sink, size_t chunkRows = 1000);
 	std::vector<std::vector<std::string>>	getLastAlarms			(const std::string& pvName) override;
 	std::vector<std::vector<std::string>>	getAlarmsLog			(const std::string& pvName) override;
 	std::vector<std::vector<std::string>>	checkAlarmNotifications	(void) override;
+	std::shared_ptr<const PVWaveform>		getWaveform				(const std::string& pvName);
 	std::vector<std::string> 				checkAlarm				(const std::string& pvName, bool ignoreMinor = false);
 
 	void 									dbSystemLogin			(void);
 	void 									dbSystemLogout			(void);
 
  private:
-	void 									handleAlarmsForFSM		(const std::string& fsmTransitionName, ConfigurationTree LinkToAlarmsToMonitor);
+	void 									handleAlarmsForFSM		(const std::string& fsmTransitionName);
 
  public:
 
 	virtual void 							configure				(void) override;
-	virtual void 							halt					(void) override { handleAlarmsForFSM("halt",		getSelfNode().getNode("LinkToHaltAlarmsToMonitorTable")); }
-	virtual void 							pause					(void) override { handleAlarmsForFSM("pause",		getSelfNode().getNode("LinkToPauseAlarmsToMonitorTable")); }
-	virtual void 							resume					(void) override { handleAlarmsForFSM("resume",		getSelfNode().getNode("LinkToResumeAlarmsToMonitorTable")); }
-	virtual void 							start					(std::string /*runNumber*/) override  { handleAlarmsForFSM("start",getSelfNode().getNode("LinkToStartAlarmsToMonitorTable")); }
-	virtual void 							stop					(void) override { handleAlarmsForFSM("stop",		getSelfNode().getNode("LinkToStopAlarmsToMonitorTable")); }
+	virtual void 							halt					(void) override { handleAlarmsForFSM("halt"); }
+	virtual void 							pause					(void) override { handleAlarmsForFSM("pause"); }
+	virtual void 							resume					(void) override { handleAlarmsForFSM("resume"); runningFullCheck_ = true; }
+	virtual void 							start					(std::string /*runNumber*/) override  { handleAlarmsForFSM("start"); runningFullCheck_ = true; }
+	virtual void 							stop					(void) override { handleAlarmsForFSM("stop"); }
 
 	// States
-	virtual bool 							running					(void) override { handleAlarmsForFSM("running",		getSelfNode().getNode("LinkToRunningAlarmsToMonitorTable")); sleep(1); return true;}
+	virtual bool 							running					(void) override;
 	//This is a workloop/thread, by default do nothing and end thread during running (Note: return true would repeat call)
 
   private:
+	// Optional field of this interface's table: defaultValue if it is empty
+	//	or the table version predates it
+	template<class T>
+	T										optionalField			(const std::string& field, const T& defaultValue)
+	{
+		try
+		{
+			return getSelfNode().getNode(field).template getValueWithDefault<T>(defaultValue);
+		}
+		catch(...)
+		{
+			return defaultValue;  // older table versions do not have the field
+		}
+	}
+
 	bool 									checkIfPVExists			(const std::string& pvName);
+	PVInfo*									findPVInfo				(const std::string& pvName);
+	PVInfo*									addPVInfo				(const std::string& pvName);
+	std::vector<PVInfo*>					getPVInfos				(void) const;
+	void 									loadHistoryDepthSettings(void);
+	unsigned int							getHistoryDepth			(const std::string& pvName) const;
+	long long								copyHistoryFromMemory	(PVInfo* pvInfo, long long startNs, long long endNs, MemoryHistory& memory);
 	void 									loadListOfPVs			(void);
+	unsigned int 							createChannels			(void);
+	bool 									writeArchiveChannels	(PGConnectionPool::Lease& db, const std::vector<ArchiveChannelConfig>& channels);
+	void 									writeArchiveChannelsPipelined(PGConnectionPool::Lease& db, const std::vector<ArchiveChannelConfig>& channels);
+	std::unordered_map<std::string, uint64_t> loadChannelFingerprints(PGConnectionPool::Lease& db, const std::string& sourceTable);
+	void 									saveChannelFingerprints	(PGConnectionPool::Lease& db, const std::string& sourceTable, const std::vector<ArchiveChannelConfig>& written, const std::vector<std::string>& removed);
+	void 									readChannelFingerprints	(void);  // from fingerprintFileName_
+	void 									writeChannelFingerprints(void);
+	bool 									streamArchiveSamples	(const std::string& pvName, double startTime, double endTime, const std::function<bool(const ArchiveSample& sample)>& onSample);
+	bool 									streamCachedArchiveSamples(const std::string& pvName, double startTime, double endTime, const std::function<bool(const ArchiveSample& sample)>& onSample);
+	bool 									loadSnapshot			(void);
+	void 									writeSnapshot			(void);
+	void 									startSnapshotThread		(void);
+	void 									stopSnapshotThread		(void);
+	void 									waitForReconcile		(void);
 	void 									getControlValues		(const std::string& pvName);
-	void									createChannel			(const std::string& pvName);
+	bool									createChannel			(const std::string& pvName);
 	void 									destroyChannel			(const std::string& pvName);
 	void 									subscribeToChannel		(const std::string& pvName, chtype subscriptionType);
 	void 									cancelSubscriptionToChannel(const std::string& pvName);
 	void 									readValueFromPV			(const std::string& pvName);
-	void 									writePVValueToRecord	(const std::string& pvName, const std::string& pdata);
+	void 									writePVValueToRecord	(PVInfo* pvInfo, const PVSample& sample);
+	void 									registerHistoryChunk	(PVInfo* pvInfo);
+	void 									compileAlarmWatches		(void);
+	void 									updateAlarmWatches		(PVInfo* pvInfo);
+	void 									setAlarmWatchActive		(unsigned int watch, bool active);
+	static bool								isAlarmActive			(const PVSnapshot& snapshot, bool ignoreMinor);
+	std::array<std::string, 4> 				formatCurrentValue		(PVInfo* pvInfo);
+	void 									compileFSMAlarmSets		(void);
+	void 									postAlarmEvent			(PVInfo* pvInfo);
+	void 									startAlarmMonitorThread	(void);
+	void 									stopAlarmMonitorThread	(void);
+	bool 									drainAlarmEvents		(void);
+	void 									writePVWaveformToRecord	(PVInfo* pvInfo, long dbrType, unsigned long count, const void* values, const epicsTimeStamp& stamp);
 	//void writePVControlValueToRecord(std::string pvName, struct dbr_ctrl_char* pdata);
-	void 									writePVControlValueToRecord(const std::string& pvName, struct dbr_ctrl_double* pdata);
-	void 									writePVAlertToQueue		(const std::string& pvName, const char* status, const char* severity);
+	void 									writePVControlValueToRecord(PVInfo* pvInfo, struct dbr_ctrl_double* pdata);
+	bool 									writePVAlertToQueue		(PVInfo* pvInfo, short status, short severity, const epicsTimeStamp& stamp);
 	void 									readPVRecord			(const std::string& pvName);
 	void 									debugConsole			(const std::string& pvName);
 	static void								eventCallback			(struct event_handler_args eha);
@@ -175,9 +856,59 @@ class EpicsInterface : public SlowControlsVInterface
 
   private:
 	//  std::map<chid, std::string> mapOfPVs_;
-	std::map<std::string, PVInfo*> 			mapOfPVInfo_;
+	std::unordered_map<std::string_view, PVInfo*>	mapOfPVInfo_;  // keys view PVInfo::pvName
+	mutable std::shared_mutex				mapMutex_;  // held exclusively only to insert; PVInfo pointers stay valid until destroy()
+	std::string								pvListJSON_;  // getList("JSON") result, rebuilt only when pvListDirty_
+	std::atomic<bool>						pvListDirty_{true};  // set when the PV set or catalog metadata changes
+	std::mutex								pvListMutex_;
+	std::shared_future<void>				reconcile_;  // catalog + CA load running behind a warm restart
+	struct ca_client_context*				caContext_ = nullptr;  // attached by the threads doing CA calls
+	std::string								snapshotFileName_;
+	std::string								fingerprintFileName_;
+	std::map<std::string, std::unordered_map<std::string, uint64_t>> channelFingerprints_;  // source table -> channel -> fingerprint, as last written
+	bool									channelFingerprintsLoaded_ = false;
+	bool									fingerprintTableProbed_ = false;  // ots_channel_fingerprint created (or refused) for ...
+	unsigned int							fingerprintTableGeneration_ = 0;  // ... this archive pool generation
+	bool									fingerprintTableAvailable_ = false;
+	std::thread								snapshotThread_;
+	std::mutex								snapshotMutex_;
+	std::condition_variable					snapshotCV_;
+	bool									snapshotThreadStop_ = false;
 	int                            			status_;
+	std::atomic<unsigned int>				connectedChannels_{0};  // channels currently up, for startup progress
+	unsigned int							historyDepthDefault_ = 10;
+	std::vector<std::pair<std::string, unsigned int>> historyDepthPatterns_;  // (wildcard pattern, depth), first match wins
+	size_t									compressedHistoryBudget_ = 0;  // bytes for all PVs, 0 = no compressed history
+	size_t									compressedHistoryBytes_  = 0;  // guarded by historyChunkMutex_
+	std::deque<PVInfo*>						historyChunkOrder_;  // owner of every compressed chunk in allocation order, guarded by historyChunkMutex_
+	std::mutex								historyChunkMutex_;  // taken before any PVInfo::historyMutex
+	ArchiveHistoryCache						historyCache_;
+	std::vector<AlarmWatchGroup>			alarmWatchGroups_;    // guarded by alarmWatchMutex_
+	std::vector<AlarmWatch>					alarmWatches_;        // in configuration order, guarded by alarmWatchMutex_
+	std::vector<unsigned int>				activeAlarmWatches_;  // watches currently in alarm, unordered, guarded by alarmWatchMutex_
+	std::mutex								alarmWatchMutex_;
+	bool									alarmWatchesCompiled_ = false;  // guarded by alarmWatchMutex_
+	size_t									alarmWatchesMissing_  = 0;      // alarms whose PV was not in the map when compiled
+	size_t									alarmWatchesMapSize_  = 0;      // mapOfPVInfo_.size() when compiled
+	std::map<std::string, FSMAlarmSet>		fsmAlarmSets_;        // transition name -> alarms, guarded by fsmAlarmMutex_
+	std::unordered_map<PVInfo*, bool>		runningAlarmPVs_;     // PVs of the running set -> ignoreMinor, guarded by fsmAlarmMutex_
+	std::mutex								fsmAlarmMutex_;
+	bool									fsmAlarmSetsCompiled_ = false;  // guarded by fsmAlarmMutex_
+	size_t									fsmAlarmSetsMissing_  = 0;
+	size_t									fsmAlarmSetsMapSize_  = 0;
+	AlarmEventQueue							alarmEvents_;  // alarm transitions from the CA callback, drained by alarmMonitorThread_
+	std::thread								alarmMonitorThread_;
+	std::mutex								alarmMonitorMutex_;
+	std::condition_variable					alarmMonitorCV_;     // wakes the monitor thread
+	std::condition_variable					runningAlarmCV_;     // wakes running()
+	bool									alarmMonitorStop_     = false;  // guarded by alarmMonitorMutex_
+	bool									alarmEventsPosted_    = false;  // guarded by alarmMonitorMutex_
+	bool									runningAlarmPending_  = false;  // guarded by alarmMonitorMutex_
+	std::atomic<bool>						runningFullCheck_{true};  // check the whole running set on the next running() call
 	std::string 							loginErrorMsg_;
+	PGConnectionPool						archivePool_;
+	PGConnectionPool						alarmPool_;
+	PGConnectionPool						logPool_;
 };
 // clang-format on
 }  // namespace ots
@@ -40,25 +40,68 @@ EpicsInterface::EpicsInterface(const std::string&       pluginType,
                                const std::string&       controlsConfigurationPath)
     : SlowControlsVInterface(pluginType, interfaceUID, theXDAQContextConfigTree, controlsConfigurationPath)
 {
+	if(getenv("SERVICE_DATA_PATH"))
+	{
+		snapshotFileName_    = std::string(getenv("SERVICE_DATA_PATH")) + "/SlowControlsDashboardData/" + interfaceUID + "_pv_snapshot.dat";
+		fingerprintFileName_ = std::string(getenv("SERVICE_DATA_PATH")) + "/SlowControlsDashboardData/" + interfaceUID + "_channel_fingerprints.txt";
+	}
+
 	// this allows for handlers to happen "asynchronously"
 	SEVCHK(ca_context_create(ca_enable_preemptive_callback),
 	       "EpicsInterface::EpicsInterface() : "
 	       "ca_enable_preemptive_callback_init()");
+	caContext_ = ca_current_context();
 }
 
 EpicsInterface::~EpicsInterface() { destroy(); }
 
 void EpicsInterface::destroy()
 {
+	// nothing else may touch the map or the db connections while tearing down
+	waitForReconcile();
+	stopSnapshotThread();
+	stopAlarmMonitorThread();
+	writeSnapshot();
+	{
+		std::lock_guard<std::mutex> lock(fsmAlarmMutex_);
+		fsmAlarmSets_.clear();
+		runningAlarmPVs_.clear();
+		fsmAlarmSetsCompiled_ = false;
+	}
+	{
+		std::lock_guard<std::mutex> lock(alarmWatchMutex_);
+		for(AlarmWatch& watch : alarmWatches_)  // CA callbacks may still come in until the channels are gone
+		{
+			watch.pvInfo->alarmWatched = false;
+			watch.pvInfo->alarmWatches.clear();
+		}
+		alarmWatchGroups_.clear();
+		alarmWatches_.clear();
+		activeAlarmWatches_.clear();
+		alarmWatchesCompiled_ = false;
+	}
+
 	// __GEN_COUT__ << "mapOfPVInfo_.size() = " << mapOfPVInfo_.size() << __E__;
 	for(auto it = mapOfPVInfo_.begin(); it != mapOfPVInfo_.end(); it++)
 	{
-		cancelSubscriptionToChannel(it->first);
-		destroyChannel(it->first);
+		cancelSubscriptionToChannel(it->second->pvName);
+		destroyChannel(it->second->pvName);
 		delete(it->second->parameterPtr);
 		delete(it->second);
-		mapOfPVInfo_.erase(it);
 	}
+	{
+		std::unique_lock<std::shared_mutex> lock(mapMutex_);
+		mapOfPVInfo_.clear();
+	}
+	pvListDirty_       = true;
+	connectedChannels_ = 0;
+	{
+		std::lock_guard<std::mutex> lock(historyChunkMutex_);
+		historyChunkOrder_.clear();
+		compressedHistoryBytes_ = 0;
+	}
+	historyCache_.clear();  // the archive may be a different one after initialize()
+	alarmEvents_.reset();   // may still link PVInfos deleted above
 
 	// __GEN_COUT__ << "mapOfPVInfo_.size() = " << mapOfPVInfo_.size() << __E__;
 	SEVCHK(ca_poll(), "EpicsInterface::destroy() : ca_poll");
@@ -70,31 +113,55 @@ void EpicsInterface::initialize()
 {
 	__GEN_COUT__ << "Epics Interface now initializing!";
 	destroy();
+	loadHistoryDepthSettings();
+	startAlarmMonitorThread();
+
+	// Warm restart: serve the last known catalog and values right away and
+	//	let the archiver catalog and live CA catch up in the background.
+	//	The cached PVs are already known, so their channels are searched for
+	//	while the databases are still being logged into.
+	if(loadSnapshot())
+	{
+		reconcile_ = std::async(std::launch::async, [this]() {
+			SEVCHK(ca_attach_context(caContext_), "EpicsInterface::initialize() : ca_attach_context");
+			std::future<void> login = std::async(std::launch::async, [this]() { dbSystemLogin(); });
+			__GEN_COUT__ << "Created " << createChannels() << " channels from the snapshot while logging in" << __E__;
+			login.get();
+			loadListOfPVs();
+			startSnapshotThread();
+		}).share();
+		return;
+	}
+
 	dbSystemLogin();
 	loadListOfPVs();
+	startSnapshotThread();
 	return;
 }
 
 std::vector<std::string> EpicsInterface::getChannelList()
 {
-	std::vector<std::string> pvList;
-	pvList.resize(mapOfPVInfo_.size());
-	for(auto pv : mapOfPVInfo_)
+	std::vector<std::string>            pvList;
+	std::shared_lock<std::shared_mutex> lock(mapMutex_);
+	pvList.reserve(mapOfPVInfo_.size());
+	for(const auto& pv : mapOfPVInfo_)
 	{
-		__GEN_COUT__ << "getPVList() add: " + pv.first << __E__;
-		pvList.push_back(pv.first);
+		if(DEBUG)
+		{
+			__GEN_COUT__ << "getPVList() add: " << pv.first << __E__;
+		}
+		pvList.push_back(pv.second->pvName);
 	}
+	lock.unlock();
+	std::sort(pvList.begin(), pvList.end());  // hash index has no order
 	return pvList;
 }
 
+//========================================================================================================================
+// The JSON list is serialized once and kept until the PV set or its catalog
+//	metadata changes, so a dashboard page load is a string copy.
 std::string EpicsInterface::getList(const std::string& format)
 {
-	std::string pvList;
-
-	std::string refreshRate = "";
-	PGresult*   res;
-	char        buffer[1024];
-
 	// pvList = "[\"None\"]";
 	// std::cout << "SUCA: Returning pvList as: " << pvList << __E__;
 	// return pvList;
@@ -103,54 +170,45 @@ std::string EpicsInterface::getList(const std::string& format)
 
 	if(format == "JSON")
 	{
-		__GEN_COUT__ << "Getting list in JSON format! There are " << mapOfPVInfo_.size() << " pv's.";
-		if(mapOfPVInfo_.size() == 0 && loginErrorMsg_ != "")
+		std::lock_guard<std::mutex> lock(pvListMutex_);
+		if(pvListDirty_.exchange(false))
 		{
-			__GEN_SS__ << "No PVs found and error message: " << loginErrorMsg_ << __E__;
-			__GEN_SS_THROW__;
+			std::vector<std::string> channels = getChannelList();
+			__GEN_COUT__ << "Getting list in JSON format! There are " << channels.size() << " pv's.";
+
+			size_t size = 2;
+			for(const auto& pvName : channels)
+				size += pvName.size() + 4;
+
+			// pvListJSON_ = "{\"PVList\" : [";
+			pvListJSON_.clear();
+			pvListJSON_.reserve(size);
+			pvListJSON_ += "[";
+			for(const auto& pvName : channels)
+			{
+				if(pvListJSON_.size() > 1)
+					pvListJSON_ += ", ";
+				// sample rate is cached per PV by loadListOfPVs(): smplModeID == 2 ? smplPer : ""
+				pvListJSON_ += "\"";
+				pvListJSON_ += pvName;
+				pvListJSON_ += "\"";
+			}
+			pvListJSON_ += "]";  //}";
+			if(DEBUG)
+			{
+				__GEN_COUT__ << pvListJSON_ << __E__;
+			}
 		}
 
-		// pvList = "{\"PVList\" : [";
-		pvList = "[";
-		for(auto it = mapOfPVInfo_.begin(); it != mapOfPVInfo_.end(); it++)
+		if(pvListJSON_.size() <= 2 && loginErrorMsg_ != "")
 		{
-			if(dcsArchiveDbConnStatus_ == 1)
-			{
-				res = PQexec(dcsArchiveDbConn, buffer);
-				/*int num = */ snprintf(buffer, sizeof(buffer), "SELECT smpl_mode_id, smpl_per FROM channel WHERE name = '%s'", (it->first).c_str());
-
-				if(PQresultStatus(res) == PGRES_TUPLES_OK)
-				{
-					int smplMode = 0;
-					try
-					{
-						smplMode = std::stoi(PQgetvalue(res, 0, 0));
-					}
-					catch(const std::exception& e)
-					{
-					}
-					if(smplMode == 2)
-						refreshRate = PQgetvalue(res, 0, 1);
-					PQclear(res);
-					__GEN_COUT__ << "getList() \"sample rate\" SELECT result: " << it->first << ":" << refreshRate << " (smpl_mode_id = " << smplMode << ")"
-					             << __E__;
-				}
-				else
-				{
-					__GEN_COUT__ << "SELECT failed: " << PQerrorMessage(dcsArchiveDbConn) << __E__;
-					PQclear(res);
-				}
-			}
-			// pvList += "\"" + it->first + ":" + refreshRate + "\", ";
-			pvList += "\"" + it->first + "\", ";
-			//__GEN_COUT__ << it->first << __E__;
+			pvListDirty_ = true;  // try again next time
+			__GEN_SS__ << "No PVs found and error message: " << loginErrorMsg_ << __E__;
+			__GEN_SS_THROW__;
 		}
-		pvList.resize(pvList.size() - 2);
-		pvList += "]";  //}";
-		__GEN_COUT__ << pvList << __E__;
-		return pvList;
+		return pvListJSON_;
 	}
-	return pvList;
+	return "";
 }
 
 void EpicsInterface::subscribe(const std::string& pvName)
@@ -160,9 +218,13 @@ void EpicsInterface::subscribe(const std::string& pvName)
 		__GEN_COUT__ << pvName << " doesn't exist!" << __E__;
 		return;
 	}
+	// No waiting for the connection here: the native type is only known once the
+	//	channel is up, so the monitors are created from channelCallbackHandler.
+	PVInfo* pvInfo             = findPVInfo(pvName);
+	pvInfo->subscribeOnConnect = true;
 	createChannel(pvName);
-	usleep(10000);  // what makes the console hang at startup
-	subscribeToChannel(pvName, mapOfPVInfo_.find(pvName)->second->channelType);
+	if(ca_state(pvInfo->getChannel()) == cs_conn && !pvInfo->subscribed)
+		subscribeToChannel(pvName, pvInfo->channelType);
 	// SEVCHK(ca_poll(), "EpicsInterface::subscribe() : ca_poll");  //print outs
 	// that handle takeover the console; can make our own error handler
 	return;
@@ -191,8 +253,7 @@ void EpicsInterface::subscribeJSON(const std::string& JSONNameString)
 
 			if(checkIfPVExists(pvName))
 			{
-				createChannel(pvName);
-				subscribeToChannel(pvName, mapOfPVInfo_.find(pvName)->second->channelType);
+				subscribe(pvName);
 				SEVCHK(ca_poll(), "EpicsInterface::subscribeJSON : ca_poll");
 			}
 			else if(DEBUG)
@@ -214,6 +275,7 @@ void EpicsInterface::unsubscribe(const std::string& pvName)
 		return;
 	}
 
+	findPVInfo(pvName)->subscribeOnConnect = false;  // do not come back on the next reconnect
 	cancelSubscriptionToChannel(pvName);
 	return;
 }
@@ -228,7 +290,8 @@ void EpicsInterface::eventCallback(struct event_handler_args eha)
 	if(eha.status == ECA_NORMAL)
 	{
 		//		int                  i;
-		union db_access_val* pBuf = (union db_access_val*)eha.dbr;
+		union db_access_val* pBuf    = (union db_access_val*)eha.dbr;
+		PVHandlerParameters* handler = (PVHandlerParameters*)eha.usr;
 		if(DEBUG)
 		{
 			printf("channel %s: ", ca_name(eha.chid));
@@ -253,146 +316,43 @@ void EpicsInterface::eventCallback(struct event_handler_args eha)
 			{
 				__COUT__ << "Response Type: DBR_CTRL_DOUBLE" << __E__;
 			}
-			((EpicsInterface*)eha.usr)
-			    ->writePVControlValueToRecord(ca_name(eha.chid),
-			                                  ((struct dbr_ctrl_double*)eha.dbr));  // write the PV's control values to records
-			break;
-		case DBR_DOUBLE:
-			if(DEBUG)
-			{
-				__COUT__ << "Response Type: DBR_DOUBLE" << __E__;
-			}
-			((EpicsInterface*)eha.usr)->writePVValueToRecord(ca_name(eha.chid),
-			                                                 std::to_string(*((double*)eha.dbr)));  // write the PV's value to records
-			break;
-		case DBR_STS_STRING:
-			if(DEBUG)
-			{
-				__COUT__ << "Response Type: DBR_STS_STRING" << __E__;
-			}
-			((EpicsInterface*)eha.usr)
-			    ->writePVAlertToQueue(ca_name(eha.chid), epicsAlarmConditionStrings[pBuf->sstrval.status], epicsAlarmSeverityStrings[pBuf->sstrval.severity]);
-			/*if(DEBUG)
-			{
-			printf("current %s:\n", eha.count > 1?"values":"value");
-			for (i = 0; i < eha.count; i++)
-			{
-			printf("%s\t", *(&(pBuf->sstrval.value) + i));
-			if ((i+1)%6 == 0) printf("\n");
-			}
-			printf("\n");
-			}*/
-			break;
-		case DBR_STS_SHORT:
-			if(DEBUG)
-			{
-				__COUT__ << "Response Type: DBR_STS_SHORT" << __E__;
-			}
-			((EpicsInterface*)eha.usr)
-			    ->writePVAlertToQueue(ca_name(eha.chid), epicsAlarmConditionStrings[pBuf->sshrtval.status], epicsAlarmSeverityStrings[pBuf->sshrtval.severity]);
-			/*if(DEBUG)
-	  {
-	  printf("current %s:\n", eha.count > 1?"values":"value");
-	  for (i = 0; i < eha.count; i++){
-	  printf("%-10d", *(&(pBuf->sshrtval.value) + i));
-	  if ((i+1)%8 == 0) printf("\n");
-	  }
-	  printf("\n");
-	  }*/
-			break;
-		case DBR_STS_FLOAT:
-			if(DEBUG)
-			{
-				__COUT__ << "Response Type: DBR_STS_FLOAT" << __E__;
-			}
-			((EpicsInterface*)eha.usr)
-			    ->writePVAlertToQueue(ca_name(eha.chid), epicsAlarmConditionStrings[pBuf->sfltval.status], epicsAlarmSeverityStrings[pBuf->sfltval.severity]);
-			/*if(DEBUG)
-	  {
-	  printf("current %s:\n", eha.count > 1?"values":"value");
-	  for (i = 0; i < eha.count; i++){
-	  printf("-10.4f", *(&(pBuf->sfltval.value) + i));
-	  if ((i+1)%8 == 0) printf("\n");
-	  }
-	  printf("\n");
-	  }*/
-			break;
-		case DBR_STS_ENUM:
-			if(DEBUG)
-			{
-				__COUT__ << "Response Type: DBR_STS_ENUM" << __E__;
-			}
-			((EpicsInterface*)eha.usr)
-			    ->writePVAlertToQueue(ca_name(eha.chid), epicsAlarmConditionStrings[pBuf->senmval.status], epicsAlarmSeverityStrings[pBuf->senmval.severity]);
-			/*if(DEBUG)
-	  {
-			printf("current %s:\n", eha.count > 1?"values":"value");
-			for (i = 0; i < eha.count; i++){
-			        printf("%d ", *(&(pBuf->senmval.value) + i));
-			}
-			printf("\n");
-	  }*/
-			break;
-		case DBR_STS_CHAR:
-			if(DEBUG)
-			{
-				__COUT__ << "Response Type: DBR_STS_CHAR" << __E__;
-			}
-			((EpicsInterface*)eha.usr)
-			    ->writePVAlertToQueue(ca_name(eha.chid), epicsAlarmConditionStrings[pBuf->schrval.status], epicsAlarmSeverityStrings[pBuf->schrval.severity]);
-			/*if(DEBUG)
-	  {
-			printf("current %s:\n", eha.count > 1?"values":"value");
-			for (i = 0; i < eha.count; i++){
-			        printf("%-5", *(&(pBuf->schrval.value) + i));
-			        if ((i+1)%15 == 0) printf("\n");
-			}
-			printf("\n");
-	  }*/
-			break;
-		case DBR_STS_LONG:
-			if(DEBUG)
-			{
-				__COUT__ << "Response Type: DBR_STS_LONG" << __E__;
-			}
-			((EpicsInterface*)eha.usr)
-			    ->writePVAlertToQueue(ca_name(eha.chid), epicsAlarmConditionStrings[pBuf->slngval.status], epicsAlarmSeverityStrings[pBuf->slngval.severity]);
-			/*if(DEBUG)
-	  {
-			printf("current %s:\n", eha.count > 1?"values":"value");
-			for (i = 0; i < eha.count; i++){
-			        printf("%-15d", *(&(pBuf->slngval.value) + i));
-			        if((i+1)%5 == 0) printf("\n");
-			}
-			printf("\n");
-	  }*/
+			handler->webClient->writePVControlValueToRecord(handler->pvInfo,
+			                                                ((struct dbr_ctrl_double*)eha.dbr));  // write the PV's control values to records
 			break;
-		case DBR_STS_DOUBLE:
+		case DBR_TIME_STRING:
+		case DBR_TIME_SHORT:
+		case DBR_TIME_FLOAT:
+		case DBR_TIME_ENUM:
+		case DBR_TIME_CHAR:
+		case DBR_TIME_LONG:
+		case DBR_TIME_DOUBLE:
+		{
 			if(DEBUG)
 			{
-				__COUT__ << "Response Type: DBR_STS_DOUBLE" << __E__;
-			}
-			((EpicsInterface*)eha.usr)
-			    ->writePVAlertToQueue(ca_name(eha.chid), epicsAlarmConditionStrings[pBuf->sdblval.status], epicsAlarmSeverityStrings[pBuf->sdblval.severity]);
-			/*if(DEBUG)
-	  {
-			printf("current %s:\n", eha.count > 1?"values":"value");
-			for (i = 0; i < eha.count; i++){
-			        printf("%-15.4f", *(&(pBuf->sdblval.value) + i));
+				__COUT__ << "Response Type: DBR_TIME_* " << eha.type << __E__;
 			}
-			printf("\n");
-			}*/
+			// One monitor carries value and alarm state: fan it out to the
+			//	value ring, the alert queue and the alarm callback.
+			//	status/severity/stamp are a common prefix of all DBR_TIME_* types.
+			PVSample sample;
+			sample.setValue(eha.type - DBR_TIME_STRING, dbr_value_ptr(eha.dbr, eha.type));
+			sample.setTime(pBuf->tstrval.stamp);
+
+			if(handler->pvInfo->elementCount > 1)  // the ring keeps element 0, the full array is handed off by reference
+				handler->webClient->writePVWaveformToRecord(
+				    handler->pvInfo, eha.type - DBR_TIME_STRING, eha.count, dbr_value_ptr(eha.dbr, eha.type), sample.stamp);
+
+			bool alarmChanged = handler->webClient->writePVAlertToQueue(handler->pvInfo, pBuf->tstrval.status, pBuf->tstrval.severity, sample.stamp);
+			handler->webClient->writePVValueToRecord(handler->pvInfo, sample);  // write the PV's value to records
+
+			if(alarmChanged)
+				eventCallbackAlarm(eha);
 			break;
+		}
 		default:
-			if(ca_name(eha.chid))
+			if(DEBUG)
 			{
-				if(DEBUG)
-				{
-					__COUT__ << " EpicsInterface::eventCallback: PV Name = " << ca_name(eha.chid) << __E__;
-					__COUT__ << (char*)eha.dbr << __E__;
-				}
-				((EpicsInterface*)eha.usr)->writePVValueToRecord(ca_name(eha.chid),
-				                                                 (char*)eha.dbr);  // write the PV's value to records
+				__COUT__ << " EpicsInterface::eventCallback: PV Name = " << ca_name(eha.chid) << " unhandled response type " << eha.type << __E__;
 			}
 			break;
 		}
@@ -406,18 +366,23 @@ void EpicsInterface::eventCallback(struct event_handler_args eha)
 
 void EpicsInterface::eventCallbackAlarm(struct event_handler_args eha)
 {
-	__COUT__ << " EpicsInterface::eventCallbackAlarm" << __E__;
 	// chid chid = eha.chid;
 	if(eha.status == ECA_NORMAL) {
-        __COUT__ << " EpicsInterface::eventCallbackAlarm: PV Name = " << ca_name(eha.chid) << __E__;
-        if(((EpicsInterface*)eha.usr)->newAlarmCallback_ != nullptr) ((EpicsInterface*)eha.usr)->newAlarmCallback_();
+		if(DEBUG)
+			__COUT__ << " EpicsInterface::eventCallbackAlarm: PV Name = " << ca_name(eha.chid) << __E__;
+		PVHandlerParameters* handler = (PVHandlerParameters*)eha.usr;
+		handler->webClient->postAlarmEvent(handler->pvInfo);
+		if(handler->webClient->newAlarmCallback_ != nullptr) handler->webClient->newAlarmCallback_();
 	}
 	return;
 }
 
 void EpicsInterface::staticChannelCallbackHandler(struct connection_handler_args cha)
 {
-	__COUT__ << "webClientChannelCallbackHandler" << __E__;
+	if(DEBUG)
+	{
+		__COUT__ << "webClientChannelCallbackHandler" << __E__;
+	}
 
 	((PVHandlerParameters*)ca_puser(cha.chid))->webClient->channelCallbackHandler(cha);
 	return;
@@ -425,21 +390,49 @@ void EpicsInterface::staticChannelCallbackHandler(struct connection_handler_args
 
 void EpicsInterface::channelCallbackHandler(struct connection_handler_args& cha)
 {
-	std::string pv = ((PVHandlerParameters*)ca_puser(cha.chid))->pvName;
+	PVInfo*            pvInfo = ((PVHandlerParameters*)ca_puser(cha.chid))->pvInfo;
+	const std::string& pv     = pvInfo->pvName;
 	if(cha.op == CA_OP_CONN_UP)
 	{
-		__GEN_COUT__ << pv << cha.chid << " connected! " << __E__;
+		if(DEBUG)
+		{
+			__GEN_COUT__ << pv << cha.chid << " connected! " << __E__;
+		}
+		if(!pvInfo->connected)
+		{
+			pvInfo->connected = true;
+			++connectedChannels_;
+		}
 
-		mapOfPVInfo_.find(pv)->second->channelType = ca_field_type(cha.chid);
-		readPVRecord(pv);
+		pvInfo->channelType  = ca_field_type(cha.chid);
+		pvInfo->elementCount = ca_element_count(cha.chid);
+
+		// CA keeps monitors across reconnects, so they are only created the first time;
+		//	their first update carries the current value, otherwise read it once
+		if(pvInfo->subscribeOnConnect && !pvInfo->subscribed)
+			subscribeToChannel(pv, pvInfo->channelType);
+		else
+			readPVRecord(pv);
 
 		/*status_ =
-		   ca_array_get_callback(dbf_type_to_DBR_STS(mapOfPVInfo_.find(pv)->second->channelType),
+		   ca_array_get_callback(dbf_type_to_DBR_STS(pvInfo->channelType),
 		                ca_element_count(cha.chid), cha.chid, eventCallback, this);
 		   SEVCHK(status_, "ca_array_get_callback");*/
 	}
 	else
+	{
 		__GEN_COUT__ << pv << " disconnected!" << __E__;
+		if(pvInfo->connected)
+		{
+			pvInfo->connected = false;
+			--connectedChannels_;
+		}
+
+		// the ring no longer describes the PV continuously, so stop serving history from it
+		std::lock_guard<std::mutex> lock(pvInfo->historyMutex);
+		pvInfo->historySize      = 0;
+		pvInfo->compressedFromNs = LLONG_MAX;  // older compressed chunks stay until evicted, but no longer count as continuous
+	}
 
 	return;
 }
@@ -451,12 +444,97 @@ bool EpicsInterface::checkIfPVExists(const std::string& pvName)
 		__GEN_COUT__ << "EpicsInterface::checkIfPVExists(): PV Info Map Length is " << mapOfPVInfo_.size() << __E__;
 	}
 
-	if(mapOfPVInfo_.find(pvName) != mapOfPVInfo_.end())
-		return true;
-
-	return false;
+	return findPVInfo(pvName) != nullptr;
 }
 
+//========================================================================================================================
+// Copy of the PV set, to iterate without holding mapMutex_; PVInfos stay valid until destroy()
+std::vector<PVInfo*> EpicsInterface::getPVInfos() const
+{
+	std::vector<PVInfo*>                pvInfos;
+	std::shared_lock<std::shared_mutex> lock(mapMutex_);
+	pvInfos.reserve(mapOfPVInfo_.size());
+	for(const auto& pv : mapOfPVInfo_)
+		pvInfos.push_back(pv.second);
+	return pvInfos;
+}  // end getPVInfos()
+
+//========================================================================================================================
+// O(1) average lookup in the hash index
+PVInfo* EpicsInterface::findPVInfo(const std::string& pvName)
+{
+	std::shared_lock<std::shared_mutex> lock(mapMutex_);
+	auto                                it = mapOfPVInfo_.find(pvName);
+	return it == mapOfPVInfo_.end() ? nullptr : it->second;
+}  // end findPVInfo()
+
+//========================================================================================================================
+// Creates the PVInfo and its CA handler parameters once; the index key
+//	views the name stored in the PVInfo, so each name is held only once.
+PVInfo* EpicsInterface::addPVInfo(const std::string& pvName)
+{
+	std::unique_lock<std::shared_mutex> lock(mapMutex_);
+	auto                                it = mapOfPVInfo_.find(pvName);
+	if(it != mapOfPVInfo_.end())
+		return it->second;
+
+	PVInfo* pvInfo               = new PVInfo(pvName, DBR_STRING, getHistoryDepth(pvName));
+	pvInfo->parameterPtr = new PVHandlerParameters(pvName, this, pvInfo);
+	mapOfPVInfo_.emplace(std::string_view(pvInfo->pvName), pvInfo);
+	pvListDirty_ = true;
+	return pvInfo;
+}  // end addPVInfo()
+
+//========================================================================================================================
+// Optional fields of the interface table:
+//	HistoryBufferDepth           = samples kept in memory per PV (default 10)
+//	HistoryBufferDepthByPattern  = "<pattern>:<depth>, ...", e.g. "Mu2e_DTC*:600, *_Temp:120"
+//		patterns allow leading/trailing '*' and the first match wins
+//	CompressedHistoryBudgetMB    = memory for the compressed history of all PVs (default 64, 0 = off)
+//	HistoryCacheMB               = memory for archiver rows cached between history requests (default 32, 0 = off)
+void EpicsInterface::loadHistoryDepthSettings()
+{
+	historyDepthDefault_ = 10;
+	historyDepthPatterns_.clear();
+
+	unsigned int cacheMB = optionalField<unsigned int>("HistoryCacheMB", 32);
+	historyCache_.setBudget((size_t)cacheMB << 20);
+
+	unsigned int budgetMB = optionalField<unsigned int>("CompressedHistoryBudgetMB", 64);
+	compressedHistoryBudget_ = (size_t)budgetMB << 20;
+
+	historyDepthDefault_ = optionalField<unsigned int>("HistoryBufferDepth", historyDepthDefault_);
+
+	std::string patterns = optionalField<std::string>("HistoryBufferDepthByPattern", "");
+
+	for(const auto& entry : StringMacros::getVectorFromString(patterns, {','}))
+	{
+		size_t colon = entry.rfind(':');
+		if(colon == std::string::npos)
+			continue;
+		try
+		{
+			historyDepthPatterns_.push_back(std::make_pair(entry.substr(0, colon), (unsigned int)std::stoul(entry.substr(colon + 1))));
+		}
+		catch(const std::exception& e)
+		{
+			__GEN_COUT__ << "Ignoring invalid history depth pattern '" << entry << "': " << e.what() << __E__;
+		}
+	}
+
+	__GEN_COUT__ << "History depth: default " << historyDepthDefault_ << ", " << historyDepthPatterns_.size() << " pattern(s), compressed history budget "
+	             << budgetMB << " MB, history cache " << cacheMB << " MB" << __E__;
+}  // end loadHistoryDepthSettings()
+
+//========================================================================================================================
+unsigned int EpicsInterface::getHistoryDepth(const std::string& pvName) const
+{
+	for(const auto& pattern : historyDepthPatterns_)
+		if(StringMacros::wildCardMatch(pattern.first, pvName))
+			return pattern.second;
+	return historyDepthDefault_;
+}  // end getHistoryDepth()
+
 void EpicsInterface::loadListOfPVs()
 {
 	__GEN_COUT__ << "LOADING LIST OF PVS!!!!";
@@ -538,50 +616,85 @@ void EpicsInterface::loadListOfPVs()
 	    }
 	*/
 	// HERE GET PVS LIST FROM DB
-	if(dcsArchiveDbConnStatus_ == 1)
+	//	One streamed query for the whole catalog: rows are handed over one at a
+	//	time in single row mode, so neither side buffers all channels.
+	auto phaseStart = std::chrono::steady_clock::now();
+	auto elapsedMs  = [](std::chrono::steady_clock::time_point since) {
+		return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - since).count();
+	};
+
+	if(PGConnectionPool::Lease db = archivePool_.checkout())
 	{
-		PGresult*   res;
-		char        buffer[1024];
-		std::string pv_name;
-		std::string cluster = "Mu2e";
-
 		__GEN_COUT__ << "Reading database PVS List" << __E__;
-		/*int num =*/snprintf(buffer, sizeof(buffer), "SELECT COUNT(%s) FROM channel", std::string("channel_id").c_str());
-		res = PQexec(dcsArchiveDbConn, buffer);
+		if(!PQsendQuery(db.conn(),
+		                "SELECT channel.channel_id, channel.name, channel.smpl_mode_id, channel.smpl_per, num_metadata.prec, num_metadata.unit "
+		                "FROM channel LEFT JOIN num_metadata ON num_metadata.channel_id = channel.channel_id ORDER BY channel.channel_id") ||
+		   !PQsetSingleRowMode(db.conn()))
+		{
+			__GEN_COUT__ << "SELECT failed: " << PQerrorMessage(db.conn()) << __E__;
+		}
 
-		if(PQresultStatus(res) == PGRES_TUPLES_OK)
+		unsigned int rows = 0;
+		PGresult*    res;
+		while((res = PQgetResult(db.conn())) != nullptr)
 		{
-			int rows = 0;
-			rows     = std::stoi(PQgetvalue(res, 0, 0));
-			PQclear(res);
-			for(int i = 1; i <= rows; i++)
+			if(PQresultStatus(res) == PGRES_SINGLE_TUPLE)
 			{
-				/*int num =*/snprintf(buffer, sizeof(buffer), "SELECT name FROM channel WHERE channel_id = '%d'", i);
-				res = PQexec(dcsArchiveDbConn, buffer);
-				if(PQresultStatus(res) == PGRES_TUPLES_OK)
-				{
-					pv_name               = PQgetvalue(res, 0, 0);
-					mapOfPVInfo_[pv_name] = new PVInfo(DBR_STRING);
-				}
-				else
-					__GEN_COUT__ << "SELECT failed: mapOfPVInfo_ not filled for channel_id: " << i << PQerrorMessage(dcsArchiveDbConn) << __E__;
+				// on a warm restart the PV is already served from the snapshot, so publish a new entry
+				PVInfo*                    pvInfo  = addPVInfo(PQgetvalue(res, 0, 1));
+				std::shared_ptr<PVCatalog> catalog = std::make_shared<PVCatalog>(*pvInfo->loadCatalog());
+				catalog->archiverChannelID         = atoi(PQgetvalue(res, 0, 0));
+				catalog->smplModeID                = atoi(PQgetvalue(res, 0, 2));
+				catalog->smplPer                   = PQgetvalue(res, 0, 3);
+				if(!PQgetisnull(res, 0, 4))
+					catalog->prec = atoi(PQgetvalue(res, 0, 4));
+				catalog->unit = PQgetvalue(res, 0, 5);
+				pvInfo->storeCatalog(std::move(catalog));
+				++rows;
 			}
-			__GEN_COUT__ << "Finished reading database PVs List!" << __E__;
-			PQclear(res);
-		}
-		else
-		{
-			__GEN_COUT__ << "SELECT failed: " << PQerrorMessage(dcsArchiveDbConn) << __E__;
+			else if(PQresultStatus(res) != PGRES_TUPLES_OK)  // TUPLES_OK is the empty end of stream marker
+				__GEN_COUT__ << "SELECT failed: mapOfPVInfo_ filled only for " << rows << " channels: " << PQresultErrorMessage(res) << __E__;
 			PQclear(res);
 		}
+		pvListDirty_ = true;  // sample rates may have changed
+		__GEN_COUT__ << "Finished reading database PVs List! " << rows << " channels in " << elapsedMs(phaseStart) << " ms" << __E__;
 	}
 
 	__GEN_COUT__ << "Here is our pv list!" << __E__;
 	// subscribe for each pv
-	for(auto pv : mapOfPVInfo_)
+	phaseStart           = std::chrono::steady_clock::now();
+	unsigned int created = createChannels();
+	__GEN_COUT__ << "Created " << created << " channels in " << elapsedMs(phaseStart) << " ms" << __E__;
+	std::vector<PVInfo*> pvInfos = getPVInfos();
+	created                      = pvInfos.size();  // wait for those created earlier from the snapshot too
+
+	// Wait for the connections, at most ChannelConnectionTimeout seconds (default 10).
+	//	Channels still down after that keep searching and subscribe whenever their IOC appears.
+	double connectionTimeout = optionalField<double>("ChannelConnectionTimeout", 10.);
+
+	phaseStart               = std::chrono::steady_clock::now();
+	auto         lastReport  = phaseStart;
+	unsigned int connectedNow = connectedChannels_;
+	while(connectedNow < created && elapsedMs(phaseStart) < connectionTimeout * 1000)
+	{
+		ca_pend_event(0.05);  // callbacks are preemptive, this only paces the progress check
+		connectedNow = connectedChannels_;
+		if(elapsedMs(lastReport) >= 1000)
+		{
+			__GEN_COUT__ << "Connected " << connectedNow << " of " << created << " channels..." << __E__;
+			lastReport = std::chrono::steady_clock::now();
+		}
+	}
+	__GEN_COUT__ << "Connected " << connectedNow << " of " << created << " channels in " << elapsedMs(phaseStart) << " ms" << __E__;
+	if(connectedNow < created)
 	{
-		__GEN_COUT__ << pv.first << __E__;
-		subscribe(pv.first);
+		unsigned int listed = 0;
+		for(PVInfo* pvInfo : pvInfos)
+		{
+			chid channel = pvInfo->getChannel();
+			if((channel == NULL || ca_state(channel) != cs_conn) && listed++ < 20)
+				__GEN_COUT__ << "Not connected yet: " << pvInfo->pvName << __E__;
+		}
 	}
 
 	// channels are subscribed to by here.
@@ -594,19 +707,255 @@ void EpicsInterface::loadListOfPVs()
 	// }
 
 	__GEN_COUT__ << "Finished reading file and subscribing to pvs!" << __E__;
-	SEVCHK(ca_pend_event(0.0),
-	       "EpicsInterface::subscribe() : ca_pend_event(0.0)");  // Start listening
 
 	return;
 }
 
+//========================================================================================================================
+// Subscribes every PV that has no channel yet; channels already searching are left
+//	alone, recreating them would restart their search. Channels are created in batches
+//	and each batch is flushed in one go; the monitors follow from the connection
+//	callbacks as the IOCs answer. Returns the number of channels created.
+unsigned int EpicsInterface::createChannels()
+{
+	const unsigned int CONNECT_BATCH_SIZE = 1000;
+	unsigned int       created            = 0;
+	for(PVInfo* pvInfo : getPVInfos())
+	{
+		if(pvInfo->getChannel() != NULL)
+			continue;
+		if(DEBUG)
+		{
+			__GEN_COUT__ << pvInfo->pvName << __E__;
+		}
+		pvInfo->subscribeOnConnect = true;  // before the channel exists, its connection callback reads it
+		if(!createChannel(pvInfo->pvName))
+			continue;  // a concurrent subscribe() was first, and set the flag as well
+		if(++created % CONNECT_BATCH_SIZE == 0)
+			SEVCHK(ca_flush_io(), "EpicsInterface::createChannels() : ca_flush_io");
+	}
+	SEVCHK(ca_flush_io(), "EpicsInterface::createChannels() : ca_flush_io");
+	return created;
+}  // end createChannels()
+
+//========================================================================================================================
+// Warm restart snapshot: catalog, control settings and last value of every PV.
+//	Layout: "OTSPVS02", uint32 sizeof(PVSnapshot), uint32 sizeof(dbr_ctrl_double), uint32 count, then per PV
+//		uint16 length + name, int32 archiver channel_id, int32 smpl_mode_id,
+//		uint16 length + smpl_per, uint16 length + unit, int32 prec,
+//		PVSnapshot, dbr_ctrl_double (both as raw bytes; a file with other sizes is ignored)
+static const char     SNAPSHOT_MAGIC[8] = {'O', 'T', 'S', 'P', 'V', 'S', '0', '2'};
+static const uint32_t SNAPSHOT_SIZES[2] = {sizeof(PVSnapshot), sizeof(dbr_ctrl_double)};
+static const size_t   SNAPSHOT_HEADER   = sizeof(SNAPSHOT_MAGIC) + sizeof(SNAPSHOT_SIZES) + sizeof(uint32_t);
+static_assert(std::is_trivially_copyable<PVSnapshot>::value, "PVSnapshot is written as raw bytes");
+
+//========================================================================================================================
+// Maps the snapshot file and creates a PVInfo for every entry, with its last value published.
+//	Returns false if there is no usable snapshot.
+bool EpicsInterface::loadSnapshot()
+{
+	if(snapshotFileName_ == "")
+		return false;
+
+	auto startTime = std::chrono::steady_clock::now();
+
+	int fd = open(snapshotFileName_.c_str(), O_RDONLY);
+	if(fd < 0)
+	{
+		__GEN_COUT__ << "No PV snapshot at " << snapshotFileName_ << __E__;
+		return false;
+	}
+	struct stat fileStat;
+	if(fstat(fd, &fileStat) != 0 || fileStat.st_size < (off_t)SNAPSHOT_HEADER)
+	{
+		close(fd);
+		return false;
+	}
+	size_t      fileSize = fileStat.st_size;
+	const char* file     = (const char*)mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(file == MAP_FAILED)
+	{
+		__GEN_COUT__ << "Failed to map PV snapshot " << snapshotFileName_ << ": " << strerror(errno) << __E__;
+		return false;
+	}
+
+	// bounds checked reads from the mapping
+	size_t offset = 0;
+	auto   take   = [&](void* to, size_t size) {
+		if(offset + size > fileSize)
+			return false;
+		memcpy(to, file + offset, size);
+		offset += size;
+		return true;
+	};
+	auto takeString = [&](std::string& to) {
+		uint16_t size;
+		if(!take(&size, sizeof(size)) || offset + size > fileSize)
+			return false;
+		to.assign(file + offset, size);
+		offset += size;
+		return true;
+	};
+
+	char     magic[sizeof(SNAPSHOT_MAGIC)];
+	uint32_t sizes[2];
+	uint32_t count  = 0;
+	uint32_t loaded = 0;
+	if(take(magic, sizeof(magic)) && memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) == 0 && take(sizes, sizeof(sizes)) &&
+	   memcmp(sizes, SNAPSHOT_SIZES, sizeof(sizes)) == 0 && take(&count, sizeof(count)))
+	{
+		std::string     name, smplPer, unit;
+		int32_t         archiverChannelID, smplModeID, prec;
+		PVSnapshot      last;
+		dbr_ctrl_double settings;
+		for(; loaded < count; ++loaded)
+		{
+			if(!takeString(name) || !take(&archiverChannelID, sizeof(archiverChannelID)) || !take(&smplModeID, sizeof(smplModeID)) || !takeString(smplPer) ||
+			   !takeString(unit) || !take(&prec, sizeof(prec)) || !take(&last, sizeof(last)) || !take(&settings, sizeof(settings)))
+			{
+				__GEN_COUT__ << "PV snapshot " << snapshotFileName_ << " is truncated after " << loaded << " of " << count << " PVs" << __E__;
+				break;
+			}
+
+			// raw bytes from disk: keep valueToString() and the units inside their arrays
+			if(last.sample.type > PVSample::ValueType::STRING)
+				last.sample.type = PVSample::ValueType::EMPTY;
+			if(last.sample.type == PVSample::ValueType::STRING)
+				last.sample.stringValue[MAX_STRING_SIZE - 1] = '\0';
+			settings.units[MAX_UNITS_SIZE - 1] = '\0';
+
+			PVInfo*                    pvInfo  = addPVInfo(name);
+			std::shared_ptr<PVCatalog> catalog = std::make_shared<PVCatalog>();
+			catalog->archiverChannelID         = archiverChannelID;
+			catalog->smplModeID                = smplModeID;
+			catalog->smplPer                   = smplPer;
+			catalog->unit                      = unit;
+			catalog->prec                      = prec;
+			pvInfo->storeCatalog(std::move(catalog));
+			pvInfo->settings.store(settings);
+			pvInfo->latest = last;
+			pvInfo->snapshot.store(last);
+		}
+	}
+	else
+		__GEN_COUT__ << "Ignoring PV snapshot " << snapshotFileName_ << " with an unknown format" << __E__;
+
+	munmap((void*)file, fileSize);
+
+	__GEN_COUT__ << "Loaded " << loaded << " PVs from snapshot " << snapshotFileName_ << " in "
+	             << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count() << " ms" << __E__;
+	return loaded > 0;
+}  // end loadSnapshot()
+
+//========================================================================================================================
+// Writes to a temporary file and renames it over the snapshot, so a crash
+//	mid-write never leaves a half written snapshot behind.
+void EpicsInterface::writeSnapshot()
+{
+	if(snapshotFileName_ == "")
+		return;
+
+	std::string buffer(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+	buffer.append((const char*)SNAPSHOT_SIZES, sizeof(SNAPSHOT_SIZES));
+	auto        put       = [&buffer](const void* from, size_t size) { buffer.append((const char*)from, size); };
+	auto        putString = [&put](const std::string& from) {
+		uint16_t size = (uint16_t)std::min(from.size(), (size_t)UINT16_MAX);
+		put(&size, sizeof(size));
+		put(from.data(), size);
+	};
+
+	uint32_t count = 0;
+	put(&count, sizeof(count));  // patched below
+	{
+		std::shared_lock<std::shared_mutex> lock(mapMutex_);
+		for(const auto& pv : mapOfPVInfo_)
+		{
+			const PVInfo*                    pvInfo            = pv.second;
+			std::shared_ptr<const PVCatalog> catalog           = pvInfo->loadCatalog();
+			int32_t                          archiverChannelID = catalog->archiverChannelID, smplModeID = catalog->smplModeID, prec = catalog->prec;
+			PVSnapshot                       last              = pvInfo->snapshot.load();
+			dbr_ctrl_double                  settings          = pvInfo->settings.load();
+
+			putString(pvInfo->pvName);
+			put(&archiverChannelID, sizeof(archiverChannelID));
+			put(&smplModeID, sizeof(smplModeID));
+			putString(catalog->smplPer);
+			putString(catalog->unit);
+			put(&prec, sizeof(prec));
+			put(&last, sizeof(last));
+			put(&settings, sizeof(settings));
+			++count;
+		}
+	}
+	if(count == 0)  // e.g. destroy() before the first initialize(), keep the previous snapshot
+		return;
+	memcpy(&buffer[SNAPSHOT_HEADER - sizeof(count)], &count, sizeof(count));
+
+	std::string   tmpFileName = snapshotFileName_ + ".tmp";
+	std::ofstream file(tmpFileName, std::ios::binary | std::ios::trunc);
+	file.write(buffer.data(), buffer.size());
+	file.close();
+	if(!file || rename(tmpFileName.c_str(), snapshotFileName_.c_str()) != 0)
+	{
+		__GEN_COUT__ << "Failed to write PV snapshot " << snapshotFileName_ << ": " << strerror(errno) << __E__;
+		return;
+	}
+	if(DEBUG)
+	{
+		__GEN_COUT__ << "Wrote " << count << " PVs to snapshot " << snapshotFileName_ << __E__;
+	}
+}  // end writeSnapshot()
+
+//========================================================================================================================
+// Rewrites the snapshot every SnapshotPeriod seconds (optional table field, default 60, 0 = only on destroy)
+void EpicsInterface::startSnapshotThread()
+{
+	unsigned int period = optionalField<unsigned int>("SnapshotPeriod", 60);
+	if(snapshotFileName_ == "" || period == 0)
+		return;
+
+	snapshotThreadStop_ = false;
+	snapshotThread_     = std::thread([this, period]() {
+		std::unique_lock<std::mutex> lock(snapshotMutex_);
+		while(!snapshotCV_.wait_for(lock, std::chrono::seconds(period), [this]() { return snapshotThreadStop_; }))
+		{
+			lock.unlock();
+			writeSnapshot();
+			lock.lock();
+		}
+	});
+}  // end startSnapshotThread()
+
+//========================================================================================================================
+void EpicsInterface::stopSnapshotThread()
+{
+	if(!snapshotThread_.joinable())
+		return;
+	{
+		std::lock_guard<std::mutex> lock(snapshotMutex_);
+		snapshotThreadStop_ = true;
+	}
+	snapshotCV_.notify_all();
+	snapshotThread_.join();
+}  // end stopSnapshotThread()
+
+//========================================================================================================================
+// The db connections belong to the background load of a warm restart until it is done
+void EpicsInterface::waitForReconcile()
+{
+	if(reconcile_.valid())
+		reconcile_.wait();
+}  // end waitForReconcile()
+
 void EpicsInterface::getControlValues(const std::string& pvName)
 {
 	if(true)
 	{
 		__GEN_COUT__ << "EpicsInterface::getControlValues(" << pvName << ")" << __E__;
 	}
-	if(!checkIfPVExists(pvName))
+	PVInfo* pvInfo = findPVInfo(pvName);
+	if(!pvInfo)
 	{
 		__GEN_COUT__ << pvName << " doesn't exist!" << __E__;
 		return;
@@ -616,77 +965,72 @@ void EpicsInterface::getControlValues(const std::string& pvName)
 	           // DBR_CTRL_CHAR,
 	           DBR_CTRL_DOUBLE,
 	           0,
-	           mapOfPVInfo_.find(pvName)->second->channelID,
+	           pvInfo->channelID,
 	           eventCallback,
-	           this),
+	           pvInfo->parameterPtr),
 	       "ca_array_get_callback");
 	// SEVCHK(ca_poll(), "EpicsInterface::getControlValues() : ca_poll");
 	return;
 }
 
-void EpicsInterface::createChannel(const std::string& pvName)
+// Returns true if the channel was created by this call. An existing channel is kept
+//	even while disconnected: CA keeps searching for it and reconnects by itself.
+bool EpicsInterface::createChannel(const std::string& pvName)
 {
-	if(!checkIfPVExists(pvName))
+	PVInfo* pvInfo = findPVInfo(pvName);
+	if(!pvInfo)
 	{
 		__GEN_COUT__ << pvName << " doesn't exist!" << __E__;
-		return;
+		return false;
 	}
-	__GEN_COUT__ << "Trying to create channel to " << pvName << ":" << mapOfPVInfo_.find(pvName)->second->channelID << __E__;
 
-	if(mapOfPVInfo_.find(pvName)->second != NULL)                 // Check to see if the pvName
-	                                                              // maps to a null pointer so we
-	                                                              // don't have any errors
-		if(mapOfPVInfo_.find(pvName)->second->channelID != NULL)  // channel might exist, subscription doesn't so create a
-		                                                          // subscription
-		{
-			// if state of channel is connected then done, use it
-			if(ca_state(mapOfPVInfo_.find(pvName)->second->channelID) == cs_conn)
-			{
-				if(DEBUG)
-				{
-					__GEN_COUT__ << "Channel to " << pvName << " already exists!" << __E__;
-				}
-				return;
-			}
-			if(DEBUG)
-			{
-				__GEN_COUT__ << "Channel to " << pvName << " exists, but is not connected! Destroying current channel." << __E__;
-			}
-			destroyChannel(pvName);
-		}
+	// subscribe() and createChannels() may race for the same PV
+	std::lock_guard<std::mutex> lock(pvInfo->channelMutex);
+	if(DEBUG)
+	{
+		__GEN_COUT__ << "Trying to create channel to " << pvName << ":" << pvInfo->channelID << __E__;
+	}
 
-	// create pvs handler
-	if(mapOfPVInfo_.find(pvName)->second->parameterPtr == NULL)
+	if(pvInfo->channelID != NULL)
 	{
-		mapOfPVInfo_.find(pvName)->second->parameterPtr = new PVHandlerParameters(pvName, this);
+		if(DEBUG)
+		{
+			__GEN_COUT__ << "Channel to " << pvName << " already exists!" << __E__;
+		}
+		return false;
 	}
 
+	// pvs handler was created with the PVInfo (see addPVInfo)
+
 	// at this point, make a new channel
-	SEVCHK(
-	    ca_create_channel(
-	        pvName.c_str(), staticChannelCallbackHandler, mapOfPVInfo_.find(pvName)->second->parameterPtr, 0, &(mapOfPVInfo_.find(pvName)->second->channelID)),
-	    "EpicsInterface::createChannel() : ca_create_channel");
-	__GEN_COUT__ << "channelID: " << pvName << mapOfPVInfo_.find(pvName)->second->channelID << __E__;
+	SEVCHK(ca_create_channel(pvName.c_str(), staticChannelCallbackHandler, pvInfo->parameterPtr, 0, &(pvInfo->channelID)),
+	       "EpicsInterface::createChannel() : ca_create_channel");
+	if(DEBUG)
+	{
+		__GEN_COUT__ << "channelID: " << pvName << pvInfo->channelID << __E__;
+	}
 
-	SEVCHK(ca_replace_access_rights_event(mapOfPVInfo_.find(pvName)->second->channelID, accessRightsCallback),
+	SEVCHK(ca_replace_access_rights_event(pvInfo->channelID, accessRightsCallback),
 	       "EpicsInterface::createChannel() : ca_replace_access_rights_event");
 	// SEVCHK(ca_poll(), "EpicsInterface::createChannel() : ca_poll"); //This
 	// routine will perform outstanding channel access background activity and then
 	// return.
-	return;
+	return true;
 }
 
 void EpicsInterface::destroyChannel(const std::string& pvName)
 {
-	if(mapOfPVInfo_.find(pvName)->second != NULL)
+	PVInfo* pvInfo = findPVInfo(pvName);
+	if(pvInfo)
 	{
-		if(mapOfPVInfo_.find(pvName)->second->channelID != NULL)
+		std::lock_guard<std::mutex> lock(pvInfo->channelMutex);
+		if(pvInfo->channelID != NULL)
 		{
-			status_ = ca_clear_channel(mapOfPVInfo_.find(pvName)->second->channelID);
+			status_ = ca_clear_channel(pvInfo->channelID);
 			SEVCHK(status_, "EpicsInterface::destroyChannel() : ca_clear_channel");
 			if(status_ == ECA_NORMAL)
 			{
-				mapOfPVInfo_.find(pvName)->second->channelID = NULL;
+				pvInfo->channelID = NULL;
 				if(DEBUG)
 				{
 					__GEN_COUT__ << "Killed channel to " << pvName << __E__;
@@ -709,7 +1053,10 @@ void EpicsInterface::accessRightsCallback(struct access_rights_handler_args args
 {
 	chid chid = args.chid;
 
-	printChidInfo(chid, "EpicsInterface::createChannel() : accessRightsCallback");
+	if(DEBUG)
+	{
+		printChidInfo(chid, "EpicsInterface::createChannel() : accessRightsCallback");
+	}
 }
 
 void EpicsInterface::printChidInfo(chid chid, const std::string& message)
@@ -722,78 +1069,76 @@ void EpicsInterface::printChidInfo(chid chid, const std::string& message)
 
 void EpicsInterface::subscribeToChannel(const std::string& pvName, chtype /*subscriptionType*/)
 {
-	if(!checkIfPVExists(pvName))
+	PVInfo* pvInfo = findPVInfo(pvName);
+	if(!pvInfo)
 	{
 		__GEN_COUT__ << pvName << " doesn't exist!" << __E__;
 		return;
 	}
 	if(DEBUG)
 	{
-		__GEN_COUT__ << "Trying to subscribe to " << pvName << ":" << mapOfPVInfo_.find(pvName)->second->channelID << __E__;
+		__GEN_COUT__ << "Trying to subscribe to " << pvName << ":" << pvInfo->channelID << __E__;
 	}
 
-	if(mapOfPVInfo_.find(pvName)->second != NULL)  // Check to see if the pvName
-	                                               // maps to a null pointer so we
-	                                               // don't have any errors
+	// subscribe() and the connection callback run on different threads and may
+	//	both get here; only the one that claims the PV creates the monitors
+	if(pvInfo->subscribed.exchange(true))
 	{
-		if(mapOfPVInfo_.find(pvName)->second->eventID != NULL)  // subscription already exists
+		if(DEBUG)
 		{
-			if(DEBUG)
-			{
-				__GEN_COUT__ << "Already subscribed to " << pvName << "!" << __E__;
-			}
-			// FIXME No way to check if the event ID is valid
-			// Just cancel the subscription if it already exists?
+			__GEN_COUT__ << "Already subscribed to " << pvName << "!" << __E__;
 		}
+		return;
 	}
 
 	//	int i=0;
-	//	while(ca_state(mapOfPVInfo_.find(pvName)->second->channelID) == cs_conn
+	//	while(ca_state(pvInfo->channelID) == cs_conn
 	//&& i<2) 		Sleep(1); 	if(i==2)
 	//		{__SS__;throw std::runtime_error(ss.str() + "Channel failed for "
 	//+
 	// pvName);}
 
-	SEVCHK(ca_create_subscription(dbf_type_to_DBR(mapOfPVInfo_.find(pvName)->second->channelType),
-	                              1,
-	                              mapOfPVInfo_.find(pvName)->second->channelID,
-	                              DBE_VALUE | DBE_ALARM | DBE_PROPERTY,
-	                              eventCallback,
-	                              this,
-	                              &(mapOfPVInfo_.find(pvName)->second->eventID)),
-	       "EpicsInterface::subscribeToChannel() : ca_create_subscription "
-	       "dbf_type_to_DBR");
-
-	SEVCHK(ca_create_subscription(DBR_STS_DOUBLE,
-	                              1,
-	                              mapOfPVInfo_.find(pvName)->second->channelID,
-	                              DBE_VALUE | DBE_ALARM | DBE_PROPERTY,
-	                              eventCallback,
-	                              this,
-	                              &(mapOfPVInfo_.find(pvName)->second->eventID)),
+	// Native type and element count are only known once connected
+	chtype fieldType = pvInfo->channelType;
+	if(ca_state(pvInfo->channelID) == cs_conn)
+	{
+		fieldType            = ca_field_type(pvInfo->channelID);
+		pvInfo->elementCount = ca_element_count(pvInfo->channelID);
+	}
+
+	// One DBR_TIME monitor delivers value, status, severity and timestamp together.
+	//	Waveforms ask for count 0, i.e. the IOC's current length up to the native count.
+	int status = ca_create_subscription(dbf_type_to_DBR_TIME(fieldType),
+	                                    pvInfo->elementCount > 1 ? 0 : 1,
+	                                    pvInfo->channelID,
+	                                    DBE_VALUE | DBE_ALARM,
+	                                    eventCallback,
+	                                    pvInfo->parameterPtr,
+	                                    &(pvInfo->eventID));
+	SEVCHK(status,
 	       "EpicsInterface::subscribeToChannel() : ca_create_subscription "
-	       "DBR_STS_DOUBLE");
-
-	SEVCHK(ca_create_subscription(DBR_CTRL_DOUBLE,
-	                              1,
-	                              mapOfPVInfo_.find(pvName)->second->channelID,
-	                              DBE_VALUE | DBE_ALARM | DBE_PROPERTY,
-	                              eventCallback,
-	                              this,
-	                              &(mapOfPVInfo_.find(pvName)->second->eventID)),
-	       "EpicsInterface::subscribeToChannel() : ca_create_subscription");
-	SEVCHK(ca_create_subscription(DBR_CTRL_DOUBLE,
-	                              1,
-	                              mapOfPVInfo_.find(pvName)->second->channelID,
-	                              DBE_ALARM,
-	                              eventCallbackAlarm,
-	                              this,
-	                              &(mapOfPVInfo_.find(pvName)->second->eventID)),
-	       "EpicsInterface::subscribeToChannel() : ca_create_subscription");
+	       "dbf_type_to_DBR_TIME");
+	if(status != ECA_NORMAL)
+	{
+		pvInfo->subscribed = false;  // let the next connect try again
+		return;
+	}
+
+	// Limits and units only change on DBE_PROPERTY
+	if(fieldType != DBF_STRING)
+		SEVCHK(ca_create_subscription(DBR_CTRL_DOUBLE,
+		                              1,
+		                              pvInfo->channelID,
+		                              DBE_PROPERTY,
+		                              eventCallback,
+		                              pvInfo->parameterPtr,
+		                              &(pvInfo->ctrlEventID)),
+		       "EpicsInterface::subscribeToChannel() : ca_create_subscription "
+		       "DBR_CTRL_DOUBLE");
 
 	if(DEBUG)
 	{
-		__GEN_COUT__ << "EpicsInterface::subscribeToChannel: Created Subscription to " << mapOfPVInfo_.find(pvName)->first << "!\n" << __E__;
+		__GEN_COUT__ << "EpicsInterface::subscribeToChannel: Created Subscription to " << pvName << "!\n" << __E__;
 	}
 	// SEVCHK(ca_poll(), "EpicsInterface::subscribeToChannel() : ca_poll");
 	return;
@@ -801,16 +1146,25 @@ void EpicsInterface::subscribeToChannel(const std::string& pvName, chtype /*subs
 
 void EpicsInterface::cancelSubscriptionToChannel(const std::string& pvName)
 {
-	if(mapOfPVInfo_.find(pvName)->second != NULL)
-		if(mapOfPVInfo_.find(pvName)->second->eventID != NULL)
+	PVInfo* pvInfo = findPVInfo(pvName);
+	if(pvInfo)
+		if(pvInfo->eventID != NULL)
 		{
-			status_ = ca_clear_subscription(mapOfPVInfo_.find(pvName)->second->eventID);
-			SEVCHK(status_,
+			if(pvInfo->ctrlEventID != NULL)
+			{
+				SEVCHK(ca_clear_subscription(pvInfo->ctrlEventID),
+				       "EpicsInterface::cancelSubscriptionToChannel() : "
+				       "ca_clear_subscription DBR_CTRL_DOUBLE");
+				pvInfo->ctrlEventID = NULL;
+			}
+			status_ = ca_clear_subscription(pvInfo->eventID);
+			SEVCHK(status_,
 			       "EpicsInterface::cancelSubscriptionToChannel() : "
 			       "ca_clear_subscription");
 			if(status_ == ECA_NORMAL)
 			{
-				mapOfPVInfo_.find(pvName)->second->eventID = NULL;
+				pvInfo->eventID    = NULL;
+				pvInfo->subscribed = false;
 				if(DEBUG)
 				{
 					__GEN_COUT__ << "Killed subscription to " << pvName << __E__;
@@ -842,26 +1196,21 @@ void EpicsInterface::readValueFromPV(const std::string& /*pvName*/)
 	return;
 }
 
-void EpicsInterface::writePVControlValueToRecord(const std::string& pvName,
+void EpicsInterface::writePVControlValueToRecord(PVInfo* pvInfo,
                                                  //                                                 struct dbr_ctrl_char*
                                                  //                                                 pdata)
                                                  struct dbr_ctrl_double* pdata)
 {
 	if(DEBUG)
 	{
-		__GEN_COUT__ << "Reading Control Values from " << pvName << "!" << __E__;
+		__GEN_COUT__ << "Reading Control Values from " << pvInfo->pvName << "!" << __E__;
 	}
 
-	if(!checkIfPVExists(pvName))
-	{
-		__GEN_COUT__ << pvName << " doesn't exist!" << __E__;
-		return;
-	}
-	mapOfPVInfo_.find(pvName)->second->settings = *pdata;
+	pvInfo->settings.store(*pdata);
 
 	if(DEBUG)
 	{
-		__GEN_COUT__ << "pvName: " << pvName << __E__;
+		__GEN_COUT__ << "pvName: " << pvInfo->pvName << __E__;
 		__GEN_COUT__ << "status: " << pdata->status << __E__;
 		__GEN_COUT__ << "severity: " << pdata->severity << __E__;
 		__GEN_COUT__ << "units: " << pdata->units << __E__;
@@ -879,101 +1228,549 @@ void EpicsInterface::writePVControlValueToRecord(const std::string& pvName,
 	return;
 }
 
-// Enforces the circular buffer
-void EpicsInterface::writePVValueToRecord(const std::string& pvName, const std::string& pdata)
+//========================================================================================================================
+// Copies a single native value out of a CA buffer; dbrType is a plain DBR_* type
+void PVSample::setValue(long dbrType, const void* value)
 {
-	std::pair<time_t, std::string> currentRecord(time(0), pdata);
+	switch(dbrType)
+	{
+	case DBR_DOUBLE:
+		type        = ValueType::DOUBLE;
+		doubleValue = *(const dbr_double_t*)value;
+		break;
+	case DBR_FLOAT:
+		type        = ValueType::DOUBLE;
+		doubleValue = *(const dbr_float_t*)value;
+		break;
+	case DBR_LONG:
+		type      = ValueType::LONG;
+		longValue = *(const dbr_long_t*)value;
+		break;
+	case DBR_SHORT:
+		type      = ValueType::LONG;
+		longValue = *(const dbr_short_t*)value;
+		break;
+	case DBR_CHAR:
+		type      = ValueType::LONG;
+		longValue = *(const dbr_char_t*)value;
+		break;
+	case DBR_ENUM:
+		type      = ValueType::ENUM;
+		enumValue = *(const dbr_enum_t*)value;
+		break;
+	case DBR_STRING:
+		type = ValueType::STRING;
+		strncpy(stringValue, (const char*)value, sizeof(stringValue) - 1);
+		stringValue[sizeof(stringValue) - 1] = '\0';
+		break;
+	default:
+		type = ValueType::EMPTY;
+		break;
+	}
+}  // end PVSample::setValue()
 
-	if(!checkIfPVExists(pvName))
+//========================================================================================================================
+// Keeps the IOC's timestamp so samples inside the same second stay ordered.
+//	A record that was never processed has a zero stamp; use arrival time then.
+void PVSample::setTime(const epicsTimeStamp& iocStamp)
+{
+	if(iocStamp.secPastEpoch != 0 || iocStamp.nsec != 0)
 	{
-		__GEN_COUT__ << pvName << " doesn't exist!" << __E__;
+		stamp = iocStamp;
 		return;
 	}
-	// __GEN_COUT__ << pdata << __E__;
 
-	PVInfo* pvInfo = mapOfPVInfo_.find(pvName)->second;
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	stamp.secPastEpoch = now.tv_sec - POSIX_TIME_AT_EPICS_EPOCH;
+	stamp.nsec         = now.tv_nsec;
+}  // end PVSample::setTime()
+
+//========================================================================================================================
+long long PVSample::timeNs() const
+{
+	return ((long long)stamp.secPastEpoch + POSIX_TIME_AT_EPICS_EPOCH) * 1000000000LL + stamp.nsec;
+}  // end PVSample::timeNs()
+
+//========================================================================================================================
+// POSIX seconds with a nanosecond fraction, e.g. "1697500000.123456789"
+std::string PVSample::timeToString() const
+{
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%lld.%09u", (long long)stamp.secPastEpoch + POSIX_TIME_AT_EPICS_EPOCH, (unsigned int)stamp.nsec);
+	return buffer;
+}  // end PVSample::timeToString()
+
+//========================================================================================================================
+// Values are formatted only on request, never in the CA callback
+std::string PVSample::valueToString() const
+{
+	switch(type)
+	{
+	case ValueType::DOUBLE:
+		return std::to_string(doubleValue);
+	case ValueType::LONG:
+		return std::to_string(longValue);
+	case ValueType::ENUM:
+		return std::to_string(enumValue);
+	case ValueType::STRING:
+		return std::string(stringValue);
+	default:
+		return "";
+	}
+}  // end PVSample::valueToString()
+
+//========================================================================================================================
+bool PVSample::valueToDouble(double& value) const
+{
+	switch(type)
+	{
+	case ValueType::DOUBLE:
+		value = doubleValue;
+		return true;
+	case ValueType::LONG:
+		value = longValue;
+		return true;
+	case ValueType::ENUM:
+		value = enumValue;
+		return true;
+	default:
+		return false;
+	}
+}  // end PVSample::valueToDouble()
+
+//========================================================================================================================
+bool PVSample::sameValue(const PVSample& other) const
+{
+	if(type != other.type)
+		return false;
+	switch(type)
+	{
+	case ValueType::DOUBLE:
+		return memcmp(&doubleValue, &other.doubleValue, sizeof(doubleValue)) == 0;
+	case ValueType::LONG:
+		return longValue == other.longValue;
+	case ValueType::ENUM:
+		return enumValue == other.enumValue;
+	case ValueType::STRING:
+		return strncmp(stringValue, other.stringValue, MAX_STRING_SIZE) == 0;
+	default:
+		return true;
+	}
+}  // end PVSample::sameValue()
+
+// Enforces the circular buffer
+//	The ring stays in IOC time order so it can be binary searched: samples older
+//	than the newest one are dropped. A sample with the newest stamp is kept unless
+//	it is an exact repeat (e.g. the initial get racing the first monitor); IOCs
+//	without a time source or records with TSE may stamp real changes alike.
+void EpicsInterface::writePVValueToRecord(PVInfo* pvInfo, const PVSample& sample)
+{
+	pvInfo->latest.sample = sample;
+	bool newChunk         = false;
 
-	if(pvInfo->mostRecentBufferIndex != pvInfo->dataCache.size() - 1 && pvInfo->mostRecentBufferIndex != (unsigned int)(-1))
 	{
-		if(pvInfo->dataCache[pvInfo->mostRecentBufferIndex].first == currentRecord.first)
+		std::lock_guard<std::mutex> lock(pvInfo->historyMutex);
+
+		if(pvInfo->historySize == 0)
+			pvInfo->valueChange = true;
+		else
 		{
-			pvInfo->valueChange = true;  // false;
+			const PVSnapshot& newest   = pvInfo->historyAt(pvInfo->historySize - 1);
+			long long         newestNs = newest.sample.timeNs();
+			bool              repeat   = newestNs == sample.timeNs() && newest.sample.sameValue(sample) && newest.status == pvInfo->latest.status &&
+			                  newest.severity == pvInfo->latest.severity;
+			pvInfo->valueChange = !repeat && newestNs <= sample.timeNs();
 		}
-		else
+		if(pvInfo->valueChange)
 		{
-			pvInfo->valueChange = true;
+			pvInfo->dataCache[pvInfo->historyHead] = pvInfo->latest;
+			pvInfo->historyHead                    = (pvInfo->historyHead + 1) % pvInfo->circularBufferSize;
+			if(pvInfo->historySize < pvInfo->circularBufferSize)
+				++pvInfo->historySize;
+
+			// numeric samples also go to the compressed tier behind the ring
+			double value;
+			if(compressedHistoryBudget_ && sample.valueToDouble(value))
+			{
+				if(pvInfo->compressedFromNs == LLONG_MAX)
+					pvInfo->compressedFromNs = sample.timeNs();
+				if(pvInfo->compressedHistory.empty() ||
+				   !pvInfo->compressedHistory.back()->append(sample.timeNs(), value, pvInfo->latest.status, pvInfo->latest.severity))
+				{
+					pvInfo->compressedHistory.emplace_back(new HistoryChunk());
+					pvInfo->compressedHistory.back()->append(sample.timeNs(), value, pvInfo->latest.status, pvInfo->latest.severity);
+					newChunk = true;
+				}
+			}
 		}
+	}
+	if(newChunk)
+		registerHistoryChunk(pvInfo);
+
+	pvInfo->snapshot.store(pvInfo->latest);
+	if(pvInfo->alarmWatched)
+		updateAlarmWatches(pvInfo);
+	// debugConsole(pvName);
+
+	return;
+}
+
+//========================================================================================================================
+// Accounts for a chunk just added to pvInfo and evicts the oldest chunks of all PVs
+//	while over budget. Called without the PV's historyMutex held (lock order).
+void EpicsInterface::registerHistoryChunk(PVInfo* pvInfo)
+{
+	std::lock_guard<std::mutex> lock(historyChunkMutex_);
+	historyChunkOrder_.push_back(pvInfo);
+	compressedHistoryBytes_ += sizeof(HistoryChunk);
+
+	while(compressedHistoryBytes_ > compressedHistoryBudget_ && historyChunkOrder_.size() > 1)
+	{
+		PVInfo* owner = historyChunkOrder_.front();
+		historyChunkOrder_.pop_front();
+		compressedHistoryBytes_ -= sizeof(HistoryChunk);
+
+		std::lock_guard<std::mutex> ownerLock(owner->historyMutex);
+		owner->compressedHistory.pop_front();  // chunks of one PV are registered in the order they were added
+		if(owner->compressedHistory.empty())
+			owner->compressedFromNs = LLONG_MAX;  // possibly the chunk still appended to; the next sample starts over
+		else
+			owner->compressedFromNs = std::max(owner->compressedFromNs, owner->compressedHistory.front()->firstNs());  // stays LLONG_MAX after a disconnect
+	}
+}  // end registerHistoryChunk()
+
+//========================================================================================================================
+void HistoryChunk::writeBits(uint64_t value, unsigned int bits)
+{
+	while(bits)
+	{
+		unsigned int offset = bitPos_ % 64;
+		unsigned int take   = std::min(bits, 64 - offset);
+		uint64_t     part   = (value >> (bits - take)) & (take == 64 ? ~0ULL : (1ULL << take) - 1);
+		words_[bitPos_ / 64] |= part << (64 - offset - take);
+		bitPos_ += take;
+		bits -= take;
+	}
+}  // end HistoryChunk::writeBits()
+
+//========================================================================================================================
+// Timestamp: '0' same delta, else '10'/'110'/'1110'/'1111' + 14/24/40/64 bits of the zigzag delta-of-delta.
+// Value: '0' same bits, '10' XOR inside the previous window, '11' + 6 bits leading zeros + 6 bits length + XOR.
+// Alarm: '0' unchanged, '1' + status + severity.
+bool HistoryChunk::append(long long timeNs, double value, short status, short severity)
+{
+	uint64_t valueBits;
+	memcpy(&valueBits, &value, sizeof(valueBits));
 
-		++pvInfo->mostRecentBufferIndex;
-		pvInfo->dataCache[pvInfo->mostRecentBufferIndex] = currentRecord;
+	if(count_ == 0)
+	{
+		writeBits(timeNs, 64);
+		writeBits(valueBits, 64);
+		writeBits(status_ = (unsigned char)status, 8);
+		writeBits(severity_ = (unsigned char)severity, 8);
+		firstNs_ = lastNs_ = timeNs;
+		lastValue_         = valueBits;
+		count_             = 1;
+		return true;
+	}
+	if(bitPos_ + MAX_SAMPLE_BITS > BYTES * 8)
+		return false;
+
+	long long delta = (long long)((uint64_t)timeNs - (uint64_t)lastNs_);  // unsigned math, wraps instead of overflowing
+	long long dod   = (long long)((uint64_t)delta - (uint64_t)lastDelta_);
+	uint64_t  zz    = ((uint64_t)dod << 1) ^ (uint64_t)(dod >> 63);
+	if(zz == 0)
+		writeBits(0, 1);
+	else if(zz < (1ULL << 14))
+	{
+		writeBits(0b10, 2);
+		writeBits(zz, 14);
+	}
+	else if(zz < (1ULL << 24))
+	{
+		writeBits(0b110, 3);
+		writeBits(zz, 24);
+	}
+	else if(zz < (1ULL << 40))
+	{
+		writeBits(0b1110, 4);
+		writeBits(zz, 40);
 	}
 	else
 	{
-		pvInfo->dataCache[0]          = currentRecord;
-		pvInfo->mostRecentBufferIndex = 0;
+		writeBits(0b1111, 4);
+		writeBits(zz, 64);
 	}
-	// debugConsole(pvName);
 
-	return;
-}
+	uint64_t x = valueBits ^ lastValue_;
+	if(x == 0)
+		writeBits(0, 1);
+	else
+	{
+		unsigned int leading  = std::min(__builtin_clzll(x), 63);
+		unsigned int trailing = __builtin_ctzll(x);
+		if(lastLeading_ != 64 && leading >= lastLeading_ && trailing >= lastTrailing_)
+		{
+			writeBits(0b10, 2);
+			writeBits(x >> lastTrailing_, 64 - lastLeading_ - lastTrailing_);
+		}
+		else
+		{
+			unsigned int length = 64 - leading - trailing;
+			writeBits(0b11, 2);
+			writeBits(leading, 6);
+			writeBits(length - 1, 6);
+			writeBits(x >> trailing, length);
+			lastLeading_  = leading;
+			lastTrailing_ = trailing;
+		}
+	}
+
+	if((unsigned char)status == status_ && (unsigned char)severity == severity_)
+		writeBits(0, 1);
+	else
+	{
+		writeBits(1, 1);
+		writeBits(status_ = (unsigned char)status, 8);
+		writeBits(severity_ = (unsigned char)severity, 8);
+	}
+
+	lastDelta_ = delta;
+	lastNs_    = timeNs;
+	lastValue_ = valueBits;
+	++count_;
+	return true;
+}  // end HistoryChunk::append()
 
-void EpicsInterface::writePVAlertToQueue(const std::string& pvName, const char* status, const char* severity)
+//========================================================================================================================
+void HistoryChunk::forEach(const std::function<void(long long timeNs, double value, short status, short severity)>& f) const
 {
-	if(!checkIfPVExists(pvName))
+	size_t pos       = 0;
+	auto   readBits  = [&](unsigned int bits) {
+		uint64_t value = 0;
+		while(bits)
+		{
+			unsigned int offset = pos % 64;
+			unsigned int take   = std::min(bits, 64 - offset);
+			uint64_t     part   = (words_[pos / 64] >> (64 - offset - take)) & (take == 64 ? ~0ULL : (1ULL << take) - 1);
+			value               = (take == 64 ? 0 : value << take) | part;
+			pos += take;
+			bits -= take;
+		}
+		return value;
+	};
+	auto toShort = [](uint64_t byte) { return byte == 0xFF ? (short)-1 : (short)byte; };  // -1 = not known yet
+
+	long long    timeNs = 0, delta = 0;
+	uint64_t     valueBits = 0;
+	unsigned int leading = 0, trailing = 0;
+	short        status = 0, severity = 0;
+	double       value;
+	for(unsigned int i = 0; i < count_; ++i)
 	{
-		__GEN_COUT__ << pvName << " doesn't exist!" << __E__;
-		return;
+		if(i == 0)
+		{
+			timeNs    = (long long)readBits(64);
+			valueBits = readBits(64);
+			status    = toShort(readBits(8));
+			severity  = toShort(readBits(8));
+		}
+		else
+		{
+			uint64_t zz = 0;
+			if(readBits(1))
+			{
+				if(!readBits(1))
+					zz = readBits(14);
+				else if(!readBits(1))
+					zz = readBits(24);
+				else if(!readBits(1))
+					zz = readBits(40);
+				else
+					zz = readBits(64);
+			}
+			delta  = (long long)((uint64_t)delta + ((zz >> 1) ^ (0 - (zz & 1))));
+			timeNs = (long long)((uint64_t)timeNs + (uint64_t)delta);
+
+			if(readBits(1))
+			{
+				if(readBits(1))
+				{
+					leading  = readBits(6);
+					trailing = 64 - leading - (readBits(6) + 1);
+				}
+				valueBits ^= readBits(64 - leading - trailing) << trailing;
+			}
+
+			if(readBits(1))
+			{
+				status   = toShort(readBits(8));
+				severity = toShort(readBits(8));
+			}
+		}
+		memcpy(&value, &valueBits, sizeof(value));
+		f(timeNs, value, status, severity);
+	}
+}  // end HistoryChunk::forEach()
+
+//========================================================================================================================
+// The one copy out of CA's buffer goes into a pooled buffer that readers then
+//	share by reference; nothing is reallocated per update.
+void EpicsInterface::writePVWaveformToRecord(PVInfo* pvInfo, long dbrType, unsigned long count, const void* values, const epicsTimeStamp& stamp)
+{
+	size_t elementSize = dbr_value_size[dbrType];
+	size_t bytes       = elementSize * count;
+
+	if(!pvInfo->waveformPool || pvInfo->waveformPool->bufferBytes() < bytes)
+		pvInfo->waveformPool =
+		    std::make_shared<WaveformPool>(elementSize * std::max(count, pvInfo->elementCount.load()), 3 /* published + filling + one reader */);
+
+	std::shared_ptr<PVWaveform> buffer = pvInfo->waveformPool->acquire();
+	buffer->dbrType                    = dbrType;
+	buffer->count                      = count;
+	buffer->elementSize                = elementSize;
+	buffer->stamp                      = stamp;
+	memcpy(buffer->data.data(), values, bytes);
+
+	std::lock_guard<std::mutex> lock(pvInfo->waveformMutex);
+	pvInfo->waveform = std::move(buffer);
+}  // end writePVWaveformToRecord()
+
+//========================================================================================================================
+WaveformPool::WaveformPool(size_t bufferBytes, unsigned int preallocate) : bufferBytes_(bufferBytes)
+{
+	for(unsigned int i = 0; i < preallocate; ++i)
+	{
+		free_.emplace_back(new PVWaveform());
+		free_.back()->data.resize(bufferBytes_);
+	}
+}  // end WaveformPool constructor
+
+//========================================================================================================================
+std::shared_ptr<PVWaveform> WaveformPool::acquire()
+{
+	PVWaveform* buffer = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if(free_.size())
+		{
+			buffer = free_.back().release();
+			free_.pop_back();
+		}
+	}
+	if(!buffer)
+	{
+		buffer = new PVWaveform();
+		buffer->data.resize(bufferBytes_);
+	}
+
+	// the deleter keeps the pool alive for as long as any view is out
+	std::shared_ptr<WaveformPool> pool = shared_from_this();
+	return std::shared_ptr<PVWaveform>(buffer, [pool](PVWaveform* released) { pool->release(released); });
+}  // end WaveformPool::acquire()
+
+//========================================================================================================================
+void WaveformPool::release(PVWaveform* buffer)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	free_.emplace_back(buffer);
+}  // end WaveformPool::release()
+
+//========================================================================================================================
+std::string PVWaveform::elementToString(unsigned long index) const
+{
+	PVSample element;
+	element.setValue(dbrType, data.data() + index * elementSize);
+	return element.valueToString();
+}  // end PVWaveform::elementToString()
+
+//========================================================================================================================
+// Comma separated elements
+std::string PVWaveform::toString() const
+{
+	std::string values;
+	for(unsigned long i = 0; i < count; ++i)
+	{
+		if(i)
+			values += ",";
+		values += elementToString(i);
+	}
+	return values;
+}  // end PVWaveform::toString()
+
+//========================================================================================================================
+const char* PVAlerts::statusToString(void) const { return status < ALARM_NSTATUS ? epicsAlarmConditionStrings[status] : "UDF"; }
+
+//========================================================================================================================
+const char* PVAlerts::severityToString(void) const { return severity < ALARM_NSEV ? epicsAlarmSeverityStrings[severity] : "INVALID"; }
+
+//========================================================================================================================
+// Returns true if the alarm state changed. The new state is published
+//	together with the value by writePVValueToRecord.
+//	Only transitions are recorded, into a fixed size ring, so memory per PV stays bounded
+//	no matter how often the IOC repeats the same status/severity.
+bool EpicsInterface::writePVAlertToQueue(PVInfo* pvInfo, short status, short severity, const epicsTimeStamp& stamp)
+{
+	bool changed = pvInfo->latest.status != status || pvInfo->latest.severity != severity;
+	if(!changed)
+		return false;
+
+	pvInfo->latest.status   = status;
+	pvInfo->latest.severity = severity;
+
+	{
+		std::lock_guard<std::mutex> lock(pvInfo->alertsMutex);
+		pvInfo->alerts[pvInfo->alertsHead] = PVAlerts(stamp, status, severity);
+		pvInfo->alertsHead                 = (pvInfo->alertsHead + 1) % PVInfo::ALERTS_CAPACITY;
+		if(pvInfo->alertsSize < PVInfo::ALERTS_CAPACITY)
+			++pvInfo->alertsSize;
 	}
-	PVAlerts alert(time(0), status, severity);
-	mapOfPVInfo_.find(pvName)->second->alerts.push(alert);
 	//__GEN_COUT__ << "writePVAlertToQueue(): " << pvName << " " << status << " "
 	//<< severity << __E__;
 
 	// debugConsole(pvName);
 
-	return;
-}
+	return changed;
+}  // end writePVAlertToQueue()
 
 void EpicsInterface::readPVRecord(const std::string& pvName)
 {
-	status_ = ca_array_get_callback(dbf_type_to_DBR_STS(mapOfPVInfo_.find(pvName)->second->channelType),
-	                                ca_element_count(mapOfPVInfo_.find(pvName)->second->channelID),
-	                                mapOfPVInfo_.find(pvName)->second->channelID,
+	PVInfo* pvInfo = findPVInfo(pvName);
+	status_ = ca_array_get_callback(dbf_type_to_DBR_TIME(pvInfo->channelType),
+	                                ca_element_count(pvInfo->channelID),
+	                                pvInfo->channelID,
 	                                eventCallback,
-	                                this);
+	                                pvInfo->parameterPtr);
 	SEVCHK(status_, "EpicsInterface::readPVRecord(): ca_array_get_callback");
 	return;
 }
 
 void EpicsInterface::debugConsole(const std::string& pvName)
 {
+	PVInfo* pvInfo = findPVInfo(pvName);
 	__GEN_COUT__ << "==============================================================="
 	                "==============="
 	             << __E__;
-	for(unsigned int it = 0; it < mapOfPVInfo_.find(pvName)->second->dataCache.size() - 1; it++)
 	{
-		if(it == mapOfPVInfo_.find(pvName)->second->mostRecentBufferIndex)
-		{
-			__GEN_COUT__ << "-----------------------------------------------------------"
-			                "----------"
-			             << __E__;
-		}
-		__GEN_COUT__ << "Iteration: " << it << " | " << mapOfPVInfo_.find(pvName)->second->mostRecentBufferIndex << " | "
-		             << mapOfPVInfo_.find(pvName)->second->dataCache[it].second << __E__;
-		if(it == mapOfPVInfo_.find(pvName)->second->mostRecentBufferIndex)
+		std::lock_guard<std::mutex> lock(pvInfo->historyMutex);
+		for(unsigned int it = 0; it < pvInfo->historySize; it++)  // oldest first
 		{
-			__GEN_COUT__ << "-----------------------------------------------------------"
-			                "----------"
-			             << __E__;
+			__GEN_COUT__ << "Iteration: " << it << " | " << pvInfo->historySize << " | " << pvInfo->historyAt(it).sample.timeToString() << " | "
+			             << pvInfo->historyAt(it).sample.valueToString() << __E__;
 		}
 	}
 	__GEN_COUT__ << "==============================================================="
 	                "==============="
 	             << __E__;
-	__GEN_COUT__ << "Status:     "
-	             << " | " << mapOfPVInfo_.find(pvName)->second->alerts.size() << " | " << mapOfPVInfo_.find(pvName)->second->alerts.front().status << __E__;
-	__GEN_COUT__ << "Severity:   "
-	             << " | " << mapOfPVInfo_.find(pvName)->second->alerts.size() << " | " << mapOfPVInfo_.find(pvName)->second->alerts.front().severity << __E__;
+	{
+		std::lock_guard<std::mutex> lock(pvInfo->alertsMutex);
+		for(unsigned int it = 0; it < pvInfo->alertsSize; it++)  // oldest first
+		{
+			__GEN_COUT__ << "Transition: " << it << " | " << pvInfo->alertsSize << " | " << pvInfo->alertAt(it).statusToString() << " | "
+			             << pvInfo->alertAt(it).severityToString() << __E__;
+		}
+	}
 	__GEN_COUT__ << "==============================================================="
 	                "==============="
 	             << __E__;
@@ -983,13 +1780,20 @@ void EpicsInterface::debugConsole(const std::string& pvName)
 
 void EpicsInterface::popQueue(const std::string& pvName)
 {
+	PVInfo* pvInfo = findPVInfo(pvName);
 	if(DEBUG)
 	{
 		__GEN_COUT__ << "EpicsInterface::popQueue() " << __E__;
 	}
-	mapOfPVInfo_.find(pvName)->second->alerts.pop();
+	bool empty;
+	{
+		std::lock_guard<std::mutex> lock(pvInfo->alertsMutex);
+		if(pvInfo->alertsSize)
+			--pvInfo->alertsSize;  // drop the oldest transition
+		empty = pvInfo->alertsSize == 0;
+	}
 
-	if(mapOfPVInfo_.find(pvName)->second->alerts.empty())
+	if(empty)
 	{
 		readPVRecord(pvName);
 		SEVCHK(ca_poll(), "EpicsInterface::popQueue() : ca_poll");
@@ -1000,117 +1804,144 @@ void EpicsInterface::popQueue(const std::string& pvName)
 //========================================================================================================================
 std::array<std::string, 4> EpicsInterface::getCurrentValue(const std::string& pvName)
 {
-	__GEN_COUT__ << "void EpicsInterface::getCurrentValue() reached" << __E__;
-
-	if(mapOfPVInfo_.find(pvName) != mapOfPVInfo_.end())
+	PVInfo* pvInfo = findPVInfo(pvName);
+	if(DEBUG)
 	{
-		PVInfo*     pv = mapOfPVInfo_.find(pvName)->second;
-		std::string time, value, status, severity;
+		__GEN_COUT__ << "void EpicsInterface::getCurrentValue() reached" << __E__;
+	}
 
-		int index = pv->mostRecentBufferIndex;
+	if(pvInfo)
+		return formatCurrentValue(pvInfo);
 
-		__GEN_COUT__ << pv << index << __E__;
+	__GEN_COUT__ << pvName << " was not found!" << __E__;
+	__GEN_COUT__ << "Trying to resubscribe to " << pvName << __E__;
+	// subscribe(pvName);
 
-		if(0 <= index && index < pv->circularBufferSize)
-		{
-			//__GEN_COUT__ << pv->dataCache[index].first <<" "<< std::time(0)-60 <<
-			//__E__;
+	std::array<std::string, 4> currentValues = {"PV Not Found", "NF", "N/a", "N/a"};
+	// std::string currentValues [4] = {"N/a", "N/a", "N/a", "N/a"};
+	return currentValues;
+}  // end getCurrentValue()
+
+//========================================================================================================================
+// Time, Value, Status, Severity of what the CA callback thread last published
+std::array<std::string, 4> EpicsInterface::formatCurrentValue(PVInfo* pvInfo)
+{
+	std::string time, value, status, severity;
+
+	// lock-free read of what the CA callback thread last published
+	PVSnapshot snapshot = pvInfo->snapshot.load();
 
-			time     = std::to_string(pv->dataCache[index].first);
-			value    = pv->dataCache[index].second;
-			status   = pv->alerts.back().status;
-			severity = pv->alerts.back().severity;
+	if(snapshot.sample.type == PVSample::ValueType::EMPTY)
+	{
+		time     = "N/a";
+		value    = "N/a";
+		status   = "DC";
+		severity = "DC";
+	}
+	else
+	{
+		time  = snapshot.sample.timeToString();
+		value = snapshot.sample.valueToString();
+		if(pvInfo->elementCount > 1)
+		{
+			std::shared_ptr<const PVWaveform> waveform = getWaveform(pvInfo->pvName);
+			if(waveform)
+				value = waveform->toString();
 		}
-		else if(index == -1)
+		if(0 <= snapshot.status && snapshot.status < ALARM_NSTATUS && 0 <= snapshot.severity && snapshot.severity < ALARM_NSEV)
 		{
-			time     = "N/a";
-			value    = "N/a";
-			status   = "DC";
-			severity = "DC";
+			status   = epicsAlarmConditionStrings[snapshot.status];
+			severity = epicsAlarmSeverityStrings[snapshot.severity];
 		}
 		else
 		{
-			time     = "N/a";
-			value    = "N/a";
 			status   = "UDF";
 			severity = "INVALID";
 		}
-		// Time, Value, Status, Severity
+	}
+	// Time, Value, Status, Severity
 
-		__GEN_COUT__ << "Index:    " << index << __E__;
+	if(DEBUG)
+	{
 		__GEN_COUT__ << "Time:     " << time << __E__;
 		__GEN_COUT__ << "Value:    " << value << __E__;
 		__GEN_COUT__ << "Status:   " << status << __E__;
 		__GEN_COUT__ << "Severity: " << severity << __E__;
-
-		/*	if(pv->valueChange)
-		        {
-		                pv->valueChange = false;
-		        }
-		        else
-		        {
-		                __GEN_COUT__ << pvName << " has no change" << __E__;
-		                time     = "NO_CHANGE";
-		                value    = "";
-		                status   = "";
-		                severity = "";
-		        }
-		*/
-		std::array<std::string, 4> currentValues = {time, value, status, severity};
-
-		return currentValues;
 	}
-	else
+
+	/*	if(pv->valueChange)
+	        {
+	                pv->valueChange = false;
+	        }
+	        else
+	        {
+	                __GEN_COUT__ << pvName << " has no change" << __E__;
+	                time     = "NO_CHANGE";
+	                value    = "";
+	                status   = "";
+	                severity = "";
+	        }
+	*/
+	std::array<std::string, 4> currentValues = {time, value, status, severity};
+
+	return currentValues;
+}  // end formatCurrentValue()
+
+//========================================================================================================================
+// Latest full array of a waveform PV, shared by reference (no copy).
+//	Returns nullptr if the PV is unknown or no array update has arrived yet.
+std::shared_ptr<const PVWaveform> EpicsInterface::getWaveform(const std::string& pvName)
+{
+	PVInfo* pvInfo = findPVInfo(pvName);
+	if(!pvInfo)
 	{
 		__GEN_COUT__ << pvName << " was not found!" << __E__;
-		__GEN_COUT__ << "Trying to resubscribe to " << pvName << __E__;
-		// subscribe(pvName);
+		return nullptr;
 	}
 
-	std::array<std::string, 4> currentValues = {"PV Not Found", "NF", "N/a", "N/a"};
-	// std::string currentValues [4] = {"N/a", "N/a", "N/a", "N/a"};
-	return currentValues;
-}
+	std::lock_guard<std::mutex> lock(pvInfo->waveformMutex);
+	return pvInfo->waveform;
+}  // end getWaveform()
 
 //========================================================================================================================
 std::array<std::string, 9> EpicsInterface::getSettings(const std::string& pvName)
 {
 	__GEN_COUT__ << "EpicsInterface::getPVSettings() reached" << __E__;
 
-	if(mapOfPVInfo_.find(pvName) != mapOfPVInfo_.end())
+	PVInfo* pvInfo = findPVInfo(pvName);
+
+	if(pvInfo)
 	{
 		std::string units = "DC'd", upperDisplayLimit = "DC'd", lowerDisplayLimit = "DC'd", upperAlarmLimit = "DC'd", upperWarningLimit = "DC'd",
 		            lowerWarningLimit = "DC'd", lowerAlarmLimit = "DC'd", upperControlLimit = "DC'd", lowerControlLimit = "DC'd";
-		if(mapOfPVInfo_.find(pvName)->second != NULL)                 // Check to see if the pvName
-		                                                              // maps to a null pointer so
-		                                                              // we don't have any errors
-			if(mapOfPVInfo_.find(pvName)->second->channelID != NULL)  // channel might exist, subscription doesn't so create a
-			                                                          // subscription
-			{
-				// dbr_ctrl_char* set = &mapOfPVInfo_.find(pvName)->second->settings;
-				dbr_ctrl_double* set = &mapOfPVInfo_.find(pvName)->second->settings;
-
-				// sprintf(&units[0],"%d",set->units);
-				units             = set->units;
-				upperDisplayLimit = std::to_string(set->upper_disp_limit);
-				lowerDisplayLimit = std::to_string(set->lower_disp_limit);
-				upperWarningLimit = std::to_string(set->upper_warning_limit);
-				lowerWarningLimit = std::to_string(set->lower_warning_limit);
-				upperAlarmLimit   = std::to_string(set->upper_alarm_limit);
-				lowerAlarmLimit   = std::to_string(set->lower_alarm_limit);
-				upperControlLimit = std::to_string(set->upper_ctrl_limit);
-				lowerControlLimit = std::to_string(set->lower_ctrl_limit);
-
-				__GEN_COUT__ << "Units              :    " << units << __E__;
-				__GEN_COUT__ << "Upper Display Limit:    " << upperDisplayLimit << __E__;
-				__GEN_COUT__ << "Lower Display Limit:    " << lowerDisplayLimit << __E__;
-				__GEN_COUT__ << "Upper Alarm Limit  :    " << upperAlarmLimit << __E__;
-				__GEN_COUT__ << "Upper Warning Limit:    " << upperWarningLimit << __E__;
-				__GEN_COUT__ << "Lower Warning Limit:    " << lowerWarningLimit << __E__;
-				__GEN_COUT__ << "Lower Alarm Limit  :    " << lowerAlarmLimit << __E__;
-				__GEN_COUT__ << "Upper Control Limit:    " << upperControlLimit << __E__;
-				__GEN_COUT__ << "Lower Control Limit:    " << lowerControlLimit << __E__;
-			}
+		if(pvInfo->getChannel() != NULL)  // channel might exist, subscription doesn't so create a
+		                                  // subscription
+		{
+			// dbr_ctrl_char* set = &pvInfo->settings;
+			dbr_ctrl_double  settings = pvInfo->settings.load();
+			dbr_ctrl_double* set      = &settings;
+
+			// sprintf(&units[0],"%d",set->units);
+			units             = std::string(set->units, strnlen(set->units, MAX_UNITS_SIZE));
+			upperDisplayLimit = std::to_string(set->upper_disp_limit);
+			lowerDisplayLimit = std::to_string(set->lower_disp_limit);
+			upperWarningLimit = std::to_string(set->upper_warning_limit);
+			lowerWarningLimit = std::to_string(set->lower_warning_limit);
+			upperAlarmLimit   = std::to_string(set->upper_alarm_limit);
+			lowerAlarmLimit   = std::to_string(set->lower_alarm_limit);
+			upperControlLimit = std::to_string(set->upper_ctrl_limit);
+			lowerControlLimit = std::to_string(set->lower_ctrl_limit);
+
+			__GEN_COUT__ << "Units              :    " << units << __E__;
+			__GEN_COUT__ << "Upper Display Limit:    " << upperDisplayLimit << __E__;
+			__GEN_COUT__ << "Lower Display Limit:    " << lowerDisplayLimit << __E__;
+			__GEN_COUT__ << "Upper Alarm Limit  :    " << upperAlarmLimit << __E__;
+			__GEN_COUT__ << "Upper Warning Limit:    " << upperWarningLimit << __E__;
+			__GEN_COUT__ << "Lower Warning Limit:    " << lowerWarningLimit << __E__;
+			__GEN_COUT__ << "Lower Alarm Limit  :    " << lowerAlarmLimit << __E__;
+			__GEN_COUT__ << "Upper Control Limit:    " << upperControlLimit << __E__;
+			__GEN_COUT__ << "Lower Control Limit:    " << lowerControlLimit << __E__;
+		}
 
 		std::array<std::string, 9> s = {units,
 		                                upperDisplayLimit,
@@ -1134,280 +1965,1222 @@ std::array<std::string, 9> EpicsInterface::getSettings(const std::string& pvName
 	return s;
 }
 
+//========================================================================================================================
+PGResultPtr PreparedStatements::prepare(PGconn* conn, const char* name, const char* sql, int nParams)
+{
+	if(prepared_.find(name) != prepared_.end())
+		return PGResultPtr(nullptr, PQclear);
+
+	PGResultPtr res(PQprepare(conn, name, sql, nParams, NULL), PQclear);
+	if(PQresultStatus(res.get()) != PGRES_COMMAND_OK)
+		return res;  // caller reports the error like any failed query
+	prepared_.insert(name);
+	return PGResultPtr(nullptr, PQclear);
+}  // end PreparedStatements::prepare()
+
+//========================================================================================================================
+PGResultPtr PreparedStatements::exec(PGconn* conn, const char* name, const char* sql, const std::vector<std::string>& params, int resultFormat)
+{
+	if(PGResultPtr failed = prepare(conn, name, sql, params.size()))
+		return failed;
+
+	std::vector<const char*> values(params.size());
+	for(size_t i = 0; i < params.size(); ++i)
+		values[i] = params[i].c_str();
+	return PGResultPtr(PQexecPrepared(conn, name, params.size(), values.data(), NULL, NULL, resultFormat), PQclear);
+}  // end PreparedStatements::exec()
+
+//========================================================================================================================
+// Returns false if the statement could not be sent, see PQerrorMessage(conn)
+bool PreparedStatements::send(PGconn* conn, const char* name, const char* sql, const std::vector<std::string>& params, int resultFormat)
+{
+	if(prepare(conn, name, sql, params.size()))
+		return false;
+
+	std::vector<const char*> values(params.size());
+	for(size_t i = 0; i < params.size(); ++i)
+		values[i] = params[i].c_str();
+	return PQsendQueryPrepared(conn, name, params.size(), values.data(), NULL, NULL, resultFormat);
+}  // end PreparedStatements::send()
+
+//========================================================================================================================
+// Binary result decoding, values arrive in network byte order
+static long long pqGetInt8(const PGresult* res, int row, int col)
+{
+	uint64_t value;
+	memcpy(&value, PQgetvalue(res, row, col), sizeof(value));
+	return (long long)be64toh(value);
+}
+
+static int pqGetInt4(const PGresult* res, int row, int col)
+{
+	uint32_t value;
+	memcpy(&value, PQgetvalue(res, row, col), sizeof(value));
+	return (int32_t)ntohl(value);
+}
+
+static double pqGetFloat8(const PGresult* res, int row, int col)
+{
+	uint64_t bits = (uint64_t)pqGetInt8(res, row, col);
+	double   value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+// Same digits PostgreSQL prints for a float8 by default
+static std::string float8ToString(double value)
+{
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%.15g", value);
+	return buffer;
+}
+
+// One getChannelHistory row {time, value, status, severity, smpl_per}, built the
+//	same way whether the sample was held in memory or read from the archive
+static std::vector<std::string> historyRow(long long timeNs, std::string&& value, const std::string& status, const std::string& severity, std::string smplPer)
+{
+	char time[32];
+	snprintf(time, sizeof(time), "%lld.%09lld", timeNs / 1000000000LL, timeNs % 1000000000LL);
+	return std::vector<std::string>({time, std::move(value), status, severity, std::move(smplPer)});
+}
+
+// historyRow() of an in-memory sample; smplPer as formatted by archiveSmplPer()
+static std::vector<std::string> memoryHistoryRow(const MemoryHistory::Sample& sample, const std::string& smplPer)
+{
+	bool known = 0 <= sample.status && sample.status < ALARM_NSTATUS && 0 <= sample.severity && sample.severity < ALARM_NSEV;
+	return historyRow(sample.timeNs,
+	                  sample.hasValue ? float8ToString(sample.value) : (sample.raw ? sample.raw->valueToString() : ""),
+	                  known ? epicsAlarmConditionStrings[sample.status] : "UDF",
+	                  known ? epicsAlarmSeverityStrings[sample.severity] : "INVALID",
+	                  smplPer);
+}
+
+// The catalog's smpl_per text formatted like the archive's FLOAT8 column
+static std::string archiveSmplPer(const PVCatalog& catalog)
+{
+	return catalog.smplPer.size() ? float8ToString(strtod(catalog.smplPer.c_str(), nullptr)) : "";
+}
+
+// Asks the server to abandon the running query; the caller still drains PQgetResult
+static void cancelQuery(PGconn* conn)
+{
+	char      errorBuffer[256];
+	PGcancel* cancel = PQgetCancel(conn);
+	if(!cancel)
+		return;
+	PQcancel(cancel, errorBuffer, sizeof(errorBuffer));
+	PQfreeCancel(cancel);
+}
+
 //========================================================================================================================
 void EpicsInterface::dbSystemLogin()
 {
-	dcsArchiveDbConnStatus_ = 0;
-	dcsAlarmDbConnStatus_   = 0;
-	dcsLogDbConnStatus_     = 0;
-
-	char* dbname_ = const_cast<char*>(getenv("DCS_ARCHIVE_DATABASE") ? getenv("DCS_ARCHIVE_DATABASE") : "dcs_archive");
-	char* dbhost_ = const_cast<char*>(getenv("DCS_ARCHIVE_DATABASE_HOST") ? getenv("DCS_ARCHIVE_DATABASE_HOST") : "");
-	char* dbport_ = const_cast<char*>(getenv("DCS_ARCHIVE_DATABASE_PORT") ? getenv("DCS_ARCHIVE_DATABASE_PORT") : "");
-	char* dbuser_ = const_cast<char*>(getenv("DCS_ARCHIVE_DATABASE_USER") ? getenv("DCS_ARCHIVE_DATABASE_USER") : "");
-	char* dbpwd_  = const_cast<char*>(getenv("DCS_ARCHIVE_DATABASE_PWD") ? getenv("DCS_ARCHIVE_DATABASE_PWD") : "");
-
-	// open db connections
-	char dcsArchiveDbConnInfo[1024];
-	sprintf(dcsArchiveDbConnInfo,
-	        "dbname=%s host=%s port=%s  \
-		user=%s password=%s",
-	        dbname_,
-	        dbhost_,
-	        dbport_,
-	        dbuser_,
-	        dbpwd_);
+	// DCS_DB_POOL_SIZE connections at most per database (default 4), requests wait up
+	//	to DCS_DB_CHECKOUT_TIMEOUT_MS (default 5000) for one to become free
+	unsigned int poolSize  = getenv("DCS_DB_POOL_SIZE") ? std::max(1, atoi(getenv("DCS_DB_POOL_SIZE"))) : 4;
+	unsigned int timeoutMs = getenv("DCS_DB_CHECKOUT_TIMEOUT_MS") ? std::max(0, atoi(getenv("DCS_DB_CHECKOUT_TIMEOUT_MS"))) : 5000;
+
+	// DCS_<DB>_DATABASE[_HOST|_PORT|_USER|_PWD|_CONNECT_TIMEOUT_MS]
+	auto connectTimeoutMs = [](const std::string& prefix) {
+		const char* value = getenv((prefix + "_CONNECT_TIMEOUT_MS").c_str());
+		return value ? (unsigned int)std::max(0, atoi(value)) : PGConnectionPool::CONNECT_TIMEOUT_SECONDS * 1000;
+	};
+	auto connInfo = [](const std::string& prefix, const char* dbname) {
+		auto env = [&prefix](const char* suffix) {
+			const char* value = getenv((prefix + suffix).c_str());
+			return std::string(value ? value : "");
+		};
+		return "dbname=" + (getenv(prefix.c_str()) ? env("") : dbname) + " host=" + env("_HOST") + " port=" + env("_PORT") + " user=" + env("_USER") +
+		       " password=" + env("_PWD");
+	};
+
+	// all three connect at once (non-blocking, each bounded by its own timeout),
+	//	so an unreachable host costs one timeout instead of up to three
+	auto login = [&](PGConnectionPool& pool, const char* dbname, const std::string& prefix) {
+		return std::async(std::launch::async, [&pool, dbname, prefix, poolSize, timeoutMs, connInfo, connectTimeoutMs]() {
+			return pool.open(dbname, connInfo(prefix, dbname), poolSize, timeoutMs, connectTimeoutMs(prefix));
+		});
+	};
+	std::future<bool> archiveLogin = login(archivePool_, "dcs_archive", "DCS_ARCHIVE_DATABASE");
+	std::future<bool> alarmLogin   = login(alarmPool_, "dcs_alarm", "DCS_ALARM_DATABASE");
+	std::future<bool> logLogin     = login(logPool_, "dcs_log", "DCS_LOG_DATABASE");
 
 	// dcs_archive Db Connection
-	dcsArchiveDbConn = PQconnectdb(dcsArchiveDbConnInfo);
-
-	if(PQstatus(dcsArchiveDbConn) == CONNECTION_BAD)
+	if(!archiveLogin.get())
 	{
 		loginErrorMsg_ = "Unable to connect to the dcs_archive database!";
 		__GEN_COUT__ << "Unable to connect to the dcs_archive database!\n" << __E__;
-		PQfinish(dcsArchiveDbConn);
 	}
 	else
-	{
 		__GEN_COUT__ << "Connected to the dcs_archive database!\n" << __E__;
-		dcsArchiveDbConnStatus_ = 1;
-	}
 
 	// dcs_alarm Db Connection
-	dbname_ = const_cast<char*>(getenv("DCS_ALARM_DATABASE") ? getenv("DCS_ALARM_DATABASE") : "dcs_alarm");
-	dbhost_ = const_cast<char*>(getenv("DCS_ALARM_DATABASE_HOST") ? getenv("DCS_ALARM_DATABASE_HOST") : "");
-	dbport_ = const_cast<char*>(getenv("DCS_ALARM_DATABASE_PORT") ? getenv("DCS_ALARM_DATABASE_PORT") : "");
-	dbuser_ = const_cast<char*>(getenv("DCS_ALARM_DATABASE_USER") ? getenv("DCS_ALARM_DATABASE_USER") : "");
-	dbpwd_  = const_cast<char*>(getenv("DCS_ALARM_DATABASE_PWD") ? getenv("DCS_ALARM_DATABASE_PWD") : "");
-	char dcsAlarmDbConnInfo[1024];
-	sprintf(dcsAlarmDbConnInfo,
-	        "dbname=%s host=%s port=%s  \
-		user=%s password=%s",
-	        dbname_,
-	        dbhost_,
-	        dbport_,
-	        dbuser_,
-	        dbpwd_);
-
-	dcsAlarmDbConn = PQconnectdb(dcsAlarmDbConnInfo);
-
-	if(PQstatus(dcsAlarmDbConn) == CONNECTION_BAD)
+	if(!alarmLogin.get())
 	{
 		loginErrorMsg_ = "Unable to connect to the dcs_alarm database!";
 		__GEN_COUT__ << "Unable to connect to the dcs_alarm database!\n" << __E__;
-		PQfinish(dcsAlarmDbConn);
 	}
 	else
-	{
 		__GEN_COUT__ << "Connected to the dcs_alarm database!\n" << __E__;
-		dcsAlarmDbConnStatus_ = 1;
-	}
 
 	// dcs_log Db Connection
-	dbname_ = const_cast<char*>(getenv("DCS_LOG_DATABASE") ? getenv("DCS_LOG_DATABASE") : "dcs_log");
-	dbhost_ = const_cast<char*>(getenv("DCS_LOG_DATABASE_HOST") ? getenv("DCS_LOG_DATABASE_HOST") : "");
-	dbport_ = const_cast<char*>(getenv("DCS_LOG_DATABASE_PORT") ? getenv("DCS_LOG_DATABASE_PORT") : "");
-	dbuser_ = const_cast<char*>(getenv("DCS_LOG_DATABASE_USER") ? getenv("DCS_LOG_DATABASE_USER") : "");
-	dbpwd_  = const_cast<char*>(getenv("DCS_LOG_DATABASE_PWD") ? getenv("DCS_LOG_DATABASE_PWD") : "");
-	char dcsLogDbConnInfo[1024];
-	sprintf(dcsLogDbConnInfo,
-	        "dbname=%s host=%s port=%s  \
-		user=%s password=%s",
-	        dbname_,
-	        dbhost_,
-	        dbport_,
-	        dbuser_,
-	        dbpwd_);
-
-	dcsLogDbConn = PQconnectdb(dcsLogDbConnInfo);
-
-	if(PQstatus(dcsLogDbConn) == CONNECTION_BAD)
+	if(!logLogin.get())
 	{
 		loginErrorMsg_ = "Unable to connect to the dcs_log database!";
 		__GEN_COUT__ << "Unable to connect to the dcs_log database!\n" << __E__;
-		PQfinish(dcsLogDbConn);
 	}
 	else
+		__GEN_COUT__ << "Connected to the dcs_log database!\n" << __E__;
+}
+
+//========================================================================================================================
+void EpicsInterface::dbSystemLogout()
+{
+	// close() also stops reconnecting a database that is down
+	bool wasConnected = archivePool_.connected();
+	archivePool_.close();
+	if(wasConnected)
+		__GEN_COUT__ << "DCS_ARCHIVE DB CONNECTION CLOSED\n" << __E__;
+
+	wasConnected = alarmPool_.connected();
+	alarmPool_.close();
+	if(wasConnected)
+		__GEN_COUT__ << "DCS_ALARM DB CONNECTION CLOSED\n" << __E__;
+
+	wasConnected = logPool_.connected();
+	logPool_.close();
+	if(wasConnected)
+		__GEN_COUT__ << "DCS_LOG DB CONNECTION CLOSED\n" << __E__;
+}
+
+//========================================================================================================================
+// Connects one connection right away, so an unreachable database is known at login;
+//	it is then retried in the background
+bool PGConnectionPool::open(const std::string& name, const std::string& connInfo, unsigned int size, unsigned int checkoutTimeoutMs, unsigned int connectTimeoutMs)
+{
+	close();
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		name_            = name;
+		connInfo_        = connInfo;
+		size_            = std::max(1u, size);
+		checkoutTimeout_ = std::chrono::milliseconds(checkoutTimeoutMs);
+		connectTimeout_  = std::chrono::milliseconds(connectTimeoutMs);
+	}
+
+	std::unique_ptr<Connection> connection = connect(connectTimeout_);
+	if(!connection)
+	{
+		markDown("login failed");
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	idle_.push_back(std::move(connection));
+	++open_;
+	connected_ = true;
+	return true;
+}  // end PGConnectionPool::open()
+
+//========================================================================================================================
+// Idle connections are closed now, leased ones when they come back
+void PGConnectionPool::close()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	connected_ = false;
+	++generation_;
+	open_ -= idle_.size();
+	idle_.clear();
+	available_.notify_all();
+
+	stopReconnect_ = true;
+	reconnectCV_.notify_all();
+	lock.unlock();
+	if(reconnectThread_.joinable())
+		reconnectThread_.join();
+	lock.lock();
+	stopReconnect_ = false;
+}  // end PGConnectionPool::close()
+
+//========================================================================================================================
+// Non-blocking connect (PQconnectStart/PQconnectPoll) bounded by timeout
+std::unique_ptr<PGConnectionPool::Connection> PGConnectionPool::connect(std::chrono::milliseconds timeout)
+{
+	std::unique_ptr<Connection> connection(new Connection());
+	connection->conn = PQconnectStart(connInfo_.c_str());
+	if(!connection->conn || PQstatus(connection->conn) == CONNECTION_BAD)
+	{
+		__COUT__ << "Unable to connect to the " << name_ << " database: " << (connection->conn ? PQerrorMessage(connection->conn) : "out of memory") << __E__;
+		return nullptr;
+	}
+
+	auto                      deadline = std::chrono::steady_clock::now() + timeout;
+	PostgresPollingStatusType status   = PGRES_POLLING_WRITING;  // as if PQconnectPoll had returned it
+	while(status != PGRES_POLLING_OK && status != PGRES_POLLING_FAILED)
+	{
+		long long leftMs = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+		if(leftMs <= 0)
+		{
+			__COUT__ << "Unable to connect to the " << name_ << " database: no answer within " << timeout.count() << " ms" << __E__;
+			return nullptr;
+		}
+
+		struct pollfd socket = {PQsocket(connection->conn), (short)(status == PGRES_POLLING_READING ? POLLIN : POLLOUT), 0};
+		int           ready  = poll(&socket, 1, (int)std::min(leftMs, 1000LL));
+		if(ready > 0)
+			status = PQconnectPoll(connection->conn);
+		else if(ready < 0 && errno != EINTR)
+			status = PGRES_POLLING_FAILED;
+	}
+	if(status == PGRES_POLLING_FAILED)
+	{
+		__COUT__ << "Unable to connect to the " << name_ << " database: " << PQerrorMessage(connection->conn) << __E__;
+		return nullptr;
+	}
+	connection->lastUsed = std::chrono::steady_clock::now();
+	return connection;
+}  // end PGConnectionPool::connect()
+
+//========================================================================================================================
+// Trivial query bounded by timeout, so that a half-open connection fails the
+//	health check instead of holding the caller until the TCP timeout. On expiry
+//	the connection is not cancelled (PQcancel would block on the same dead link),
+//	the caller drops it instead.
+bool PGConnectionPool::ping(PGconn* conn, std::chrono::milliseconds timeout)
+{
+	if(!PQsendQuery(conn, "SELECT 1"))
+		return false;
+
+	auto deadline = std::chrono::steady_clock::now() + timeout;
+	while(PQisBusy(conn))
+	{
+		long long leftMs = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+		if(leftMs <= 0)
+		{
+			__COUT__ << "No answer from the " << name_ << " database within " << timeout.count() << " ms" << __E__;
+			return false;
+		}
+
+		struct pollfd socket = {PQsocket(conn), POLLIN, 0};
+		int           ready  = poll(&socket, 1, (int)std::min(leftMs, 1000LL));
+		if(ready > 0 && !PQconsumeInput(conn))
+			return false;
+		else if(ready < 0 && errno != EINTR)
+			return false;
+	}
+
+	bool healthy = true;
+	while(PGresult* res = PQgetResult(conn))
+	{
+		healthy = healthy && PQresultStatus(res) == PGRES_TUPLES_OK;
+		PQclear(res);
+	}
+	return healthy;
+}  // end PGConnectionPool::ping()
+
+//========================================================================================================================
+PGConnectionPool::Lease PGConnectionPool::checkout()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	if(!available_.wait_for(lock, checkoutTimeout_, [this] { return !connected_ || idle_.size() || open_ < size_; }) || !connected_)
+	{
+		if(connected_)
+			__COUT__ << "No " << name_ << " database connection became free within " << checkoutTimeout_.count() << " ms (pool size " << size_ << ")"
+			         << __E__;
+		return Lease();
+	}
+
+	std::unique_ptr<Connection> connection;
+	if(idle_.size())
+	{
+		connection = std::move(idle_.back());
+		idle_.pop_back();
+	}
+	else
+		++open_;  // reserve the slot, connect without holding the lock
+	unsigned int generation = generation_;
+	lock.unlock();
+
+	if(connection)
+	{
+		bool healthy = PQstatus(connection->conn) == CONNECTION_OK;
+		if(healthy && std::chrono::steady_clock::now() - connection->lastUsed > std::chrono::seconds(HEALTH_CHECK_IDLE_SECONDS))
+			healthy = ping(connection->conn, checkoutTimeout_);
+		if(!healthy)
+		{
+			__COUT__ << "Replacing a broken " << name_ << " database connection" << __E__;
+			connection.reset();
+		}
+	}
+	if(!connection)  // new or replacement, bounded so a dead server does not hold the caller
+		connection = connect(checkoutTimeout_);
+
+	if(!connection)
+	{
+		lock.lock();
+		--open_;
+		available_.notify_one();
+		lock.unlock();
+		markDown("connecting failed");
+		return Lease();
+	}
+	connection->generation = generation;
+	return Lease(this, std::move(connection));
+}  // end PGConnectionPool::checkout()
+
+//========================================================================================================================
+// A connection left inside a transaction, with a query in flight or still in
+//	pipeline mode is closed rather than reused
+void PGConnectionPool::giveBack(std::unique_ptr<Connection>&& connection)
+{
+	bool lost            = PQstatus(connection->conn) == CONNECTION_BAD;  // libpq notices a dropped server during a query
+	bool reusable        = !lost && PQtransactionStatus(connection->conn) == PQTRANS_IDLE;
+#ifdef LIBPQ_HAS_PIPELINING
+	reusable = reusable && PQpipelineStatus(connection->conn) == PQ_PIPELINE_OFF;
+#endif
+	connection->lastUsed = std::chrono::steady_clock::now();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if(reusable && connection->generation == generation_)
+			idle_.push_back(std::move(connection));
+		else
+		{
+			--open_;
+			connection.reset();
+		}
+		available_.notify_one();
+	}
+	if(lost)
+		markDown("connection lost");
+}  // end PGConnectionPool::giveBack()
+
+//========================================================================================================================
+// Drops the idle connections, which likely share the fate of the broken one, and starts
+//	reconnecting in the background unless already doing so or closed
+void PGConnectionPool::markDown(const std::string& reason)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	if(connected_)
+		__COUT__ << "The " << name_ << " database is down (" << reason << "), reconnecting in the background" << __E__;
+	connected_ = false;
+	open_ -= idle_.size();
+	idle_.clear();
+	available_.notify_all();
+
+	if(reconnecting_ || stopReconnect_)
+		return;
+	if(reconnectThread_.joinable())
+		reconnectThread_.join();  // the previous one is past its last use of mutex_
+	reconnecting_    = true;
+	reconnectThread_ = std::thread(&PGConnectionPool::reconnectLoop, this);
+}  // end PGConnectionPool::markDown()
+
+//========================================================================================================================
+void PGConnectionPool::reconnectLoop()
+{
+	std::chrono::seconds backoff(1);
+	std::unique_lock<std::mutex> lock(mutex_);
+	while(!reconnectCV_.wait_for(lock, backoff, [this] { return stopReconnect_; }))
+	{
+		lock.unlock();
+		std::unique_ptr<Connection> connection = connect(connectTimeout_);
+		lock.lock();
+
+		if(connection && !stopReconnect_)
+		{
+			connection->generation = generation_;
+			idle_.push_back(std::move(connection));
+			++open_;
+			connected_ = true;
+			available_.notify_all();
+			__COUT__ << "Reconnected to the " << name_ << " database" << __E__;
+			break;
+		}
+		backoff = std::min(backoff * 2, std::chrono::seconds(RECONNECT_BACKOFF_MAX_S));
+	}
+	reconnecting_ = false;
+}  // end PGConnectionPool::reconnectLoop()
+
+//========================================================================================================================
+void PGConnectionPool::Lease::release()
+{
+	if(connection_)
+		pool_->giveBack(std::move(connection_));
+	connection_.reset();
+}  // end PGConnectionPool::Lease::release()
+
+//========================================================================================================================
+void PGPipeline::queue(const std::string& tag, const char* sql, std::vector<std::string>&& params)
+{
+	statements_.push_back({tag, sql, std::move(params)});
+}  // end PGPipeline::queue()
+
+//========================================================================================================================
+bool PGPipeline::send(const Statement& statement)
+{
+	std::vector<const char*> values(statement.params.size());
+	for(size_t i = 0; i < statement.params.size(); ++i)
+		values[i] = statement.params[i].c_str();
+	return PQsendQueryParams(conn_, statement.sql, values.size(), NULL, values.data(), NULL, NULL, 0);
+}  // end PGPipeline::send()
+
+//========================================================================================================================
+std::string PGPipeline::exec(const char* sql, const std::vector<std::string>& params)
+{
+	std::vector<const char*> values(params.size());
+	for(size_t i = 0; i < params.size(); ++i)
+		values[i] = params[i].c_str();
+	PGResultPtr res(PQexecParams(conn_, sql, values.size(), NULL, values.data(), NULL, NULL, 0), PQclear);
+	if(PQresultStatus(res.get()) == PGRES_COMMAND_OK || PQresultStatus(res.get()) == PGRES_TUPLES_OK)
+		return "";
+	return res ? PQresultErrorMessage(res.get()) : PQerrorMessage(conn_);
+}  // end PGPipeline::exec()
+
+//========================================================================================================================
+std::vector<std::pair<std::string, std::string>> PGPipeline::run()
+{
+	// tags as [first, end) ranges of statements_
+	std::vector<std::pair<size_t, size_t>> tags;
+	for(size_t i = 0; i < statements_.size(); ++i)
+		if(i == 0 || statements_[i].tag != statements_[i - 1].tag)
+			tags.emplace_back(i, i + 1);
+		else
+			tags.back().second = i + 1;
+
+	std::vector<std::pair<std::string, std::string>> failed;
+	auto fail = [&](size_t t, const std::string& error) { failed.emplace_back(statements_[tags[t].first].tag, error); };
+
+#ifdef LIBPQ_HAS_PIPELINING
+	if(PQenterPipelineMode(conn_))
+	{
+		std::string lost;      // set once the connection is unusable
+		size_t      done = 0;  // tags with a known outcome
+		for(size_t first = 0; first < tags.size() && lost.empty(); first += WINDOW)
+		{
+			// send a window of tags, each closed by a sync point
+			size_t sent = first;
+			for(; sent < std::min(tags.size(), first + WINDOW); ++sent)
+			{
+				bool ok = true;
+				for(size_t i = tags[sent].first; ok && i < tags[sent].second; ++i)
+					ok = send(statements_[i]);
+				if(!ok || !PQpipelineSync(conn_))
+				{
+					lost = PQerrorMessage(conn_);
+					break;
+				}
+			}
+
+			// then read its replies: one result and a NULL per statement, then the sync
+			for(; done < sent; ++done)
+			{
+				std::string error;
+				for(size_t i = tags[done].first; i < tags[done].second && lost.empty(); ++i)
+				{
+					PGResultPtr res(PQgetResult(conn_), PQclear);
+					if(!res)
+						lost = PQerrorMessage(conn_);
+					else if(PQresultStatus(res.get()) == PGRES_FATAL_ERROR && error.empty())
+						error = PQresultErrorMessage(res.get());  // the rest of the tag comes back PGRES_PIPELINE_ABORTED
+					PGResultPtr(PQgetResult(conn_), PQclear);
+				}
+				if(lost.empty() && PQresultStatus(PGResultPtr(PQgetResult(conn_), PQclear).get()) != PGRES_PIPELINE_SYNC)
+					lost = PQerrorMessage(conn_);
+
+				if(error.size() || lost.size())
+					fail(done, error.size() ? error : lost);
+				if(lost.size())
+				{
+					++done;
+					break;
+				}
+			}
+		}
+
+		for(; done < tags.size(); ++done)
+			fail(done, lost);
+		if(lost.empty())
+			PQexitPipelineMode(conn_);  // if this fails too, giveBack() closes the connection
+		statements_.clear();
+		return failed;
+	}
+#endif
+
+	// one round trip per statement
+	for(size_t t = 0; t < tags.size(); ++t)
+	{
+		std::string error = exec("BEGIN", {});
+		for(size_t i = tags[t].first; i < tags[t].second && error.empty(); ++i)
+			error = exec(statements_[i].sql, statements_[i].params);
+		if(error.empty())
+			error = exec("COMMIT", {});
+		else
+			exec("ROLLBACK", {});
+		if(error.size())
+			fail(t, error);
+	}
+	statements_.clear();
+	return failed;
+}  // end PGPipeline::run()
+
+//========================================================================================================================
+PGConnectionPool::Lease& PGConnectionPool::Lease::operator=(Lease&& other)
+{
+	if(this != &other)
+	{
+		release();
+		pool_       = other.pool_;
+		connection_ = std::move(other.connection_);
+	}
+	return *this;
+}  // end PGConnectionPool::Lease::operator=()
+
+//========================================================================================================================
+std::vector<std::vector<std::string>> EpicsInterface::getChannelHistory(const std::string& pvName, int startTime, int endTime)
+{
+	__GEN_COUT__ << "getChannelHistory() reached" << __E__;
+	std::vector<std::vector<std::string>> history;
+
+	if(!checkIfPVExists(pvName))
+	{
+		history.resize(1);
+		history[0] = {"PV Not Found", "NF", "N/a", "N/a"};
+		__GEN_COUT__ << "getChannelHistory() pvName " << pvName << " was not found!" << __E__;
+		__GEN_COUT__ << "Trying to resubscribe to " << pvName << __E__;
+		subscribe(pvName);
+		return history;
+	}
+
+	streamChannelHistory(pvName, startTime, endTime, [&history](std::vector<std::vector<std::string>>& chunk) {
+		history.insert(history.end(), std::make_move_iterator(chunk.begin()), std::make_move_iterator(chunk.end()));
+		return true;
+	});
+	return history;
+}  // end getChannelHistory()
+
+//========================================================================================================================
+// Hands the history of pvName in [startTime, endTime) to sink in chunks of at most
+//	chunkRows rows, newest first, in the getChannelHistory row format. Only one chunk
+//	is held at a time: the archiver rows arrive one by one (libpq single row mode).
+//	The sink may move the rows out. If it returns false, e.g. because the client went
+//	away, the query is cancelled on the server and false is returned.
+bool EpicsInterface::streamChannelHistory(const std::string&                                                        pvName,
+                                          int                                                                       startTime,
+                                          int                                                                       endTime,
+                                          const std::function<bool(std::vector<std::vector<std::string>>& chunk)>& sink,
+                                          size_t                                                                    chunkRows)
+{
+	waitForReconcile();
+
+	PVInfo* pvInfo = findPVInfo(pvName);
+	if(!pvInfo)
+	{
+		__SS__ << "streamChannelHistory(): pvName " << pvName << " was not found!" << __E__;
+		__SS_THROW__;
+	}
+	if(chunkRows == 0)
+		chunkRows = 1;
+
+	std::vector<std::vector<std::string>> chunk;
+	auto                                  emit = [&](std::vector<std::string>&& row) {
+		chunk.push_back(std::move(row));
+		if(chunk.size() < chunkRows)
+			return true;
+		bool more = sink(chunk);
+		chunk.clear();
+		return more;
+	};
+
+	// newest part of the window comes from memory if it reaches back far enough
+	MemoryHistory memory;
+	long long     coveredFromNs = copyHistoryFromMemory(pvInfo, startTime * 1000000000LL, endTime * 1000000000LL, memory);
+	std::string   smplPer       = archiveSmplPer(*pvInfo->loadCatalog());
+	size_t        memoryRows    = 0;
+	if(!memory.forEach([&](const MemoryHistory::Sample& sample) {
+		   ++memoryRows;
+		   return emit(memoryHistoryRow(sample, smplPer));
+	   }))
+		return false;
+	if(coveredFromNs <= startTime * 1000000000LL)
+	{
+		__GEN_COUT__ << "streamChannelHistory(): " << memoryRows << " rows served from memory" << __E__;
+		return chunk.empty() || sink(chunk);
+	}
+
+	if(!archivePool_.connected())
+	{
+		if(memoryRows)
+		{
+			__GEN_COUT__ << "streamChannelHistory(): archiver database not connected, returning the " << memoryRows << " rows held in memory" << __E__;
+			return chunk.empty() || sink(chunk);
+		}
+		__SS__ << "getChannelHistory(): ARCHIVER DATABASE CONNECTION FAILED!!! " << __E__;
+		__SS_THROW__;
+	}
+
+	// only the older part goes to the archive
+	double dbEndTime = std::min((double)endTime, coveredFromNs / 1e9);
+	bool   completed = true;
+	size_t rows      = 0;
+	try
+	{
+		completed = streamCachedArchiveSamples(pvName, startTime, dbEndTime, [&](const ArchiveSample& sample) {
+			++rows;
+			return emit(historyRow(sample.timeNs(),
+			                       sample.hasValue ? float8ToString(sample.value) : "",
+			                       sample.status,
+			                       sample.severity,
+			                       sample.hasSmplPer ? float8ToString(sample.smplPer) : ""));
+		});
+		if(completed && chunk.size())
+			completed = sink(chunk);
+	}
+	catch(...)
+	{
+		__SS__ << "getChannelHistory(): FAILING GETTING DATA FROM ARCHIVER DATABASE!!! " << __E__;
+		try	{ throw; } //one more try to printout extra info
+		catch(const std::exception &e)
+		{
+			ss << "Exception message: " << e.what();
+		}
+		catch(...){}
+		__SS_THROW__;
+	}
+
+	if(DEBUG || !completed)
+	{
+		ArchiveHistoryCache::Stats stats = historyCache_.stats();
+		__GEN_COUT__ << "streamChannelHistory(): " << rows << " archiver rows" << (completed ? "" : ", cancelled by the client") << "; history cache "
+		             << stats.hits << " hits, " << stats.partialHits << " partial, " << stats.misses << " misses, " << stats.bytes << " bytes" << __E__;
+	}
+	return completed;
+}  // end streamChannelHistory()
+
+//========================================================================================================================
+// Archived samples of pvName in [startTime, endTime) (POSIX seconds), newest first,
+//	handed to onSample one at a time. Numeric columns come back in binary, so no float
+//	is printed and parsed on the way. Returns false if onSample asked to stop; the
+//	query is then cancelled and the connection drained so it is ready for the next one.
+bool EpicsInterface::streamArchiveSamples(const std::string&                                 pvName,
+                                          double                                             startTime,
+                                          double                                             endTime,
+                                          const std::function<bool(const ArchiveSample& sample)>& onSample)
+{
+	static const char* HISTORY_SQL =
+	    "SELECT FLOOR(EXTRACT(EPOCH FROM smpl_time))::INT8, sample.nanosecs::INT8, float_val::FLOAT8, status.name, severity.name, smpl_per::FLOAT8 "
+	    "FROM channel, sample, status, severity WHERE channel.channel_id = sample.channel_id AND sample.severity_id = severity.severity_id "
+	    "AND sample.status_id = status.status_id AND channel.name = $1 AND smpl_time >= TO_TIMESTAMP($2) AND smpl_time < TO_TIMESTAMP($3) "
+	    "ORDER BY smpl_time desc, sample.nanosecs desc";
+
+	char start[32], end[32];
+	snprintf(start, sizeof(start), "%.9f", startTime);
+	snprintf(end, sizeof(end), "%.9f", endTime);
+
+	PGConnectionPool::Lease db = archivePool_.checkout();
+	if(!db)
+	{
+		__SS__ << "streamArchiveSamples(): NO ARCHIVER DATABASE CONNECTION AVAILABLE!!! " << __E__;
+		__SS_THROW__;
+	}
+	if(!db.statements().send(db.conn(), "channel_history", HISTORY_SQL, {pvName, start, end}, 1 /*binary*/) || !PQsetSingleRowMode(db.conn()))
+	{
+		__SS__ << "streamArchiveSamples(): SELECT FROM ARCHIVER DATABASE FAILED!!! PQ ERROR: " << PQerrorMessage(db.conn()) << __E__;
+		while(PGResultPtr(PQgetResult(db.conn()), PQclear))
+			;
+		__SS_THROW__;
+	}
+
+	bool          stopped = false;
+	std::string   error;
+	ArchiveSample sample;
+	for(PGResultPtr res(PQgetResult(db.conn()), PQclear); res; res.reset(PQgetResult(db.conn())))
+	{
+		if(stopped || error.size())
+			continue;  // drain what is still in flight
+
+		if(PQresultStatus(res.get()) == PGRES_SINGLE_TUPLE)
+		{
+			sample.seconds  = pqGetInt8(res.get(), 0, 0);
+			sample.nanosecs = pqGetInt8(res.get(), 0, 1);
+			sample.hasValue = !PQgetisnull(res.get(), 0, 2);
+			sample.value    = sample.hasValue ? pqGetFloat8(res.get(), 0, 2) : 0;
+			sample.status.assign(PQgetvalue(res.get(), 0, 3), PQgetlength(res.get(), 0, 3));
+			sample.severity.assign(PQgetvalue(res.get(), 0, 4), PQgetlength(res.get(), 0, 4));
+			sample.hasSmplPer = !PQgetisnull(res.get(), 0, 5);
+			sample.smplPer    = sample.hasSmplPer ? pqGetFloat8(res.get(), 0, 5) : 0;
+
+			try
+			{
+				stopped = !onSample(sample);
+			}
+			catch(const std::exception& e)
+			{
+				error = e.what();
+			}
+			catch(...)
+			{
+				error = "unknown exception while handling a row";
+			}
+			if(stopped || error.size())
+				cancelQuery(db.conn());
+		}
+		else if(PQresultStatus(res.get()) != PGRES_TUPLES_OK)  // TUPLES_OK is the empty end of stream marker
+			error = PQresultErrorMessage(res.get());
+	}
+
+	if(error.size())
+	{
+		__SS__ << "streamArchiveSamples(): SELECT FROM ARCHIVER DATABASE FAILED!!! PQ ERROR: " << error << __E__;
+		__SS_THROW__;
+	}
+	return !stopped;
+}  // end streamArchiveSamples()
+
+//========================================================================================================================
+// streamArchiveSamples() through historyCache_: the settled part of the window is
+//	served from cached intervals and only the gaps between them are queried, then
+//	cached. Rows newer than ArchiveHistoryCache::SETTLE_SECONDS always come from the
+//	database. Same order and cancellation as streamArchiveSamples().
+bool EpicsInterface::streamCachedArchiveSamples(const std::string&                                 pvName,
+                                                double                                             startTime,
+                                                double                                             endTime,
+                                                const std::function<bool(const ArchiveSample& sample)>& onSample)
+{
+	int fromS    = (int)std::ceil(startTime);
+	int settledS = (int)std::min(std::floor(endTime), (double)(time(0) - ArchiveHistoryCache::SETTLE_SECONDS));
+	if(!historyCache_.budget() || settledS <= fromS)
+		return streamArchiveSamples(pvName, startTime, endTime, onSample);
+
+	size_t fromCache = 0, fromArchive = 0;
+	auto   fetched   = [&](const ArchiveSample& sample) {
+		++fromArchive;
+		return onSample(sample);
+	};
+
+	// newest first: the unsettled end, cached pieces and gaps, then any fraction of a second at the start
+	bool completed = endTime <= settledS || streamArchiveSamples(pvName, settledS, endTime, fetched);
+	for(const ArchiveHistoryCache::Piece& piece : historyCache_.lookup(pvName, fromS, settledS))
+	{
+		if(!completed)
+			break;
+		if(piece.samples)
+		{
+			long long fromNs = piece.fromS * 1000000000LL, toNs = piece.toS * 1000000000LL;
+			auto      sample = std::partition_point(piece.samples->begin(), piece.samples->end(), [toNs](const ArchiveSample& s) {
+				return s.timeNs() >= toNs;
+			});
+			for(; completed && sample != piece.samples->end() && sample->timeNs() >= fromNs; ++sample)
+			{
+				++fromCache;
+				completed = onSample(*sample);
+			}
+		}
+		else
+		{
+			std::vector<ArchiveSample> rows;
+			completed = streamArchiveSamples(pvName, piece.fromS, piece.toS, [&](const ArchiveSample& sample) {
+				rows.push_back(sample);
+				return fetched(sample);
+			});
+			if(completed)  // a cancelled query did not see the whole gap
+				historyCache_.insert(pvName, piece.fromS, piece.toS, std::move(rows));
+		}
+	}
+	if(completed && startTime < fromS)
+		completed = streamArchiveSamples(pvName, startTime, fromS, fetched);
+
+	historyCache_.countRows(fromCache, fromArchive);
+	return completed;
+}  // end streamCachedArchiveSamples()
+
+//========================================================================================================================
+ArchiveHistoryCache::Stats EpicsInterface::getHistoryCacheStats() const { return historyCache_.stats(); }
+
+//========================================================================================================================
+void ArchiveHistoryCache::setBudget(size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	budget_ = bytes;
+	evict();
+}  // end ArchiveHistoryCache::setBudget()
+
+//========================================================================================================================
+std::vector<ArchiveHistoryCache::Piece> ArchiveHistoryCache::lookup(const std::string& pvName, int fromS, int toS)
+{
+	std::vector<Piece>          pieces;
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	int  cursor = toS;  // everything in [cursor, toS) is planned
+	auto pv     = segments_.find(pvName);
+	if(pv != segments_.end())
+	{
+		// walk the intervals that start before toS backwards, until one ends before fromS
+		for(auto it = pv->second.lower_bound(toS); it != pv->second.begin() && cursor > fromS;)
+		{
+			--it;
+			Segment& segment = it->second;
+			if(segment.toS <= fromS)
+				break;
+			if(segment.toS < cursor)
+				pieces.push_back({segment.toS, cursor, nullptr});
+
+			cursor = std::max(it->first, fromS);
+			pieces.push_back({cursor, std::min(segment.toS, toS), segment.samples});
+			lru_.splice(lru_.begin(), lru_, segment.lru);
+		}
+	}
+	if(cursor > fromS)
+		pieces.push_back({fromS, cursor, nullptr});
+
+	size_t cached = std::count_if(pieces.begin(), pieces.end(), [](const Piece& piece) { return piece.samples != nullptr; });
+	if(cached == pieces.size())
+		++stats_.hits;
+	else if(cached)
+		++stats_.partialHits;
+	else
+		++stats_.misses;
+	return pieces;
+}  // end ArchiveHistoryCache::lookup()
+
+//========================================================================================================================
+void ArchiveHistoryCache::insert(const std::string& pvName, int fromS, int toS, std::vector<ArchiveSample>&& samples)
+{
+	if(!budget_)
+		return;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	std::map<int, Segment>&     intervals = segments_[pvName];
+
+	// absorb overlapping and adjacent intervals; another request may have cached part of the gap meanwhile
+	long long fromNs = fromS * 1000000000LL, toNs = toS * 1000000000LL;
+	bool      merged = false;
+	for(auto it = intervals.upper_bound(toS); it != intervals.begin();)
+	{
+		--it;
+		if(it->second.toS < fromS)
+			break;
+		for(const ArchiveSample& sample : *it->second.samples)
+			if(sample.timeNs() < fromNs || sample.timeNs() >= toNs)
+				samples.push_back(sample);
+		fromS  = std::min(fromS, it->first);
+		toS    = std::max(toS, it->second.toS);
+		merged = true;
+
+		stats_.bytes -= it->second.bytes;
+		lru_.erase(it->second.lru);
+		it = intervals.erase(it);
+	}
+	if(merged)
+		std::stable_sort(samples.begin(), samples.end(), [](const ArchiveSample& a, const ArchiveSample& b) { return a.timeNs() > b.timeNs(); });
+
+	size_t bytes = sizeof(Segment) + pvName.size() + samples.size() * sizeof(ArchiveSample);
+	lru_.emplace_front(pvName, fromS);
+	intervals[fromS] = {toS, std::make_shared<const std::vector<ArchiveSample>>(std::move(samples)), bytes, lru_.begin()};
+	stats_.bytes += bytes;
+	evict();
+}  // end ArchiveHistoryCache::insert()
+
+//========================================================================================================================
+void ArchiveHistoryCache::evict()
+{
+	while(stats_.bytes > budget_ && lru_.size())
+	{
+		auto pv = segments_.find(lru_.back().first);
+		auto it = pv->second.find(lru_.back().second);
+		stats_.bytes -= it->second.bytes;
+		pv->second.erase(it);
+		if(pv->second.empty())
+			segments_.erase(pv);
+		lru_.pop_back();
+		++stats_.evictions;
+	}
+}  // end ArchiveHistoryCache::evict()
+
+//========================================================================================================================
+void ArchiveHistoryCache::countRows(size_t fromCache, size_t fromArchive)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	stats_.rowsFromCache += fromCache;
+	stats_.rowsFromArchive += fromArchive;
+}  // end ArchiveHistoryCache::countRows()
+
+//========================================================================================================================
+void ArchiveHistoryCache::clear()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	segments_.clear();
+	lru_.clear();
+	stats_.bytes = 0;
+}  // end ArchiveHistoryCache::clear()
+
+//========================================================================================================================
+ArchiveHistoryCache::Stats ArchiveHistoryCache::stats() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return stats_;
+}  // end ArchiveHistoryCache::stats()
+
+//========================================================================================================================
+// History reduced to at most maxPoints buckets of equal width over [startTime, endTime),
+//	for plots that cannot show more points than they have pixels anyway.
+//	Rows are newest first: {bucket start time, min, max, mean, last, sample count}, empty buckets are left out.
+//	The archiver aggregates its part in SQL (width_bucket), the in-memory ring is reduced here;
+//	if the aggregate query fails the raw archiver rows are streamed through the same reduction.
+std::vector<std::vector<std::string>> EpicsInterface::getChannelHistoryDownsampled(const std::string& pvName, int startTime, int endTime, unsigned int maxPoints)
+{
+	static const char* DOWNSAMPLE_SQL =
+	    "SELECT width_bucket(EXTRACT(EPOCH FROM smpl_time)::FLOAT8, $2::FLOAT8, $3::FLOAT8, $4::INT4) - 1 AS bucket, MIN(float_val)::FLOAT8, "
+	    "MAX(float_val)::FLOAT8, SUM(float_val)::FLOAT8, COUNT(*)::INT8, "
+	    "(ARRAY_AGG(float_val ORDER BY smpl_time DESC, sample.nanosecs DESC))[1]::FLOAT8, "
+	    "MAX(FLOOR(EXTRACT(EPOCH FROM smpl_time))::INT8 * 1000000000 + sample.nanosecs)::INT8 "
+	    "FROM channel, sample WHERE channel.channel_id = sample.channel_id AND channel.name = $1 AND float_val IS NOT NULL "
+	    "AND smpl_time >= TO_TIMESTAMP($2) AND smpl_time < TO_TIMESTAMP($5) GROUP BY bucket";
+
+	__GEN_COUT__ << "getChannelHistoryDownsampled() reached" << __E__;
+	waitForReconcile();
+
+	PVInfo* pvInfo = findPVInfo(pvName);
+	if(!pvInfo)
+	{
+		__SS__ << "getChannelHistoryDownsampled(): pvName " << pvName << " was not found!" << __E__;
+		__SS_THROW__;
+	}
+	if(endTime <= startTime)
+		return {};
+
+	// one bucket is allocated per point, and the SQL takes the count as INT4
+	maxPoints = std::min(std::max(maxPoints, 1u), HistoryDownsampler::MAX_BUCKETS);
+
+	long long          startNs = startTime * 1000000000LL, endNs = endTime * 1000000000LL;
+	HistoryDownsampler downsampler(startNs, endNs, maxPoints);
+
+	// newest part from memory, copied under the PV's lock and reduced after releasing it
+	MemoryHistory memory;
+	long long     coveredFromNs = copyHistoryFromMemory(pvInfo, startNs, endNs, memory);
+	memory.forEach([&downsampler](const MemoryHistory::Sample& sample) {
+		if(sample.hasValue)
+			downsampler.add(sample.timeNs, sample.value);
+		return true;
+	});
+
+	// older part from the archive
+	if(coveredFromNs > startNs && archivePool_.connected())
+	{
+		double dbEndTime = std::min((double)endTime, coveredFromNs / 1e9);
+		char   start[32], end[32], dbEnd[32];
+		snprintf(start, sizeof(start), "%d", startTime);
+		snprintf(end, sizeof(end), "%d", endTime);
+		snprintf(dbEnd, sizeof(dbEnd), "%.9f", dbEndTime);
+
+		PGConnectionPool::Lease db = archivePool_.checkout();
+		if(!db)
+		{
+			__SS__ << "getChannelHistoryDownsampled(): NO ARCHIVER DATABASE CONNECTION AVAILABLE!!! " << __E__;
+			__SS_THROW__;
+		}
+		PGResultPtr res = db.statements().exec(
+		    db.conn(), "channel_history_downsampled", DOWNSAMPLE_SQL, {pvName, start, end, std::to_string(maxPoints), dbEnd}, 1 /*binary*/);
+		if(PQresultStatus(res.get()) == PGRES_TUPLES_OK)
+		{
+			for(int i = 0; i < PQntuples(res.get()); i++)
+				downsampler.merge(pqGetInt4(res.get(), i, 0),
+				                  pqGetFloat8(res.get(), i, 1),
+				                  pqGetFloat8(res.get(), i, 2),
+				                  pqGetFloat8(res.get(), i, 3),
+				                  pqGetInt8(res.get(), i, 4),
+				                  pqGetFloat8(res.get(), i, 5),
+				                  pqGetInt8(res.get(), i, 6));
+		}
+		else
+		{
+			__GEN_COUT__ << "getChannelHistoryDownsampled(): aggregate query failed, reducing raw rows instead. PQ ERROR: " << PQresultErrorMessage(res.get())
+			             << __E__;
+			db.release();  // streamArchiveSamples() checks out its own
+			streamArchiveSamples(pvName, startTime, dbEndTime, [&downsampler](const ArchiveSample& sample) {
+				if(sample.hasValue)
+					downsampler.add(sample.seconds * 1000000000LL + sample.nanosecs, sample.value);
+				return true;
+			});
+		}
+	}
+	else if(coveredFromNs > startNs)
+		__GEN_COUT__ << "getChannelHistoryDownsampled(): archiver database not connected, using the samples held in memory only" << __E__;
+
+	return downsampler.toRows();
+}  // end getChannelHistoryDownsampled()
+
+//========================================================================================================================
+HistoryDownsampler::HistoryDownsampler(long long startNs, long long endNs, unsigned int buckets) : startNs_(startNs), endNs_(endNs), buckets_(buckets) {}
+
+//========================================================================================================================
+// Same bucket boundaries as width_bucket(t, start, end, n) - 1
+long long HistoryDownsampler::bucketOf(long long timeNs) const
+{
+	if(timeNs < startNs_ || timeNs >= endNs_)
+		return -1;
+	return (long long)((double)(timeNs - startNs_) * buckets_.size() / (double)(endNs_ - startNs_));
+}  // end HistoryDownsampler::bucketOf()
+
+//========================================================================================================================
+long long HistoryDownsampler::bucketStartNs(unsigned int bucket) const
+{
+	return startNs_ + (long long)((double)(endNs_ - startNs_) * bucket / buckets_.size());
+}  // end HistoryDownsampler::bucketStartNs()
+
+//========================================================================================================================
+void HistoryDownsampler::merge(long long bucket, double min, double max, double sum, unsigned long long count, double last, long long lastNs)
+{
+	if(bucket < 0 || bucket >= (long long)buckets_.size() || count == 0)
+		return;
+
+	Bucket& b = buckets_[bucket];
+	if(b.count == 0 || min < b.min)
+		b.min = min;
+	if(b.count == 0 || max > b.max)
+		b.max = max;
+	b.sum += sum;
+	b.count += count;
+	if(lastNs >= b.lastNs)
 	{
-		__GEN_COUT__ << "Connected to the dcs_log database!\n" << __E__;
-		dcsLogDbConnStatus_ = 1;
+		b.last   = last;
+		b.lastNs = lastNs;
 	}
-}
+}  // end HistoryDownsampler::merge()
 
 //========================================================================================================================
-void EpicsInterface::dbSystemLogout()
+std::vector<std::vector<std::string>> HistoryDownsampler::toRows() const
 {
-	if(PQstatus(dcsArchiveDbConn) == CONNECTION_OK)
-	{
-		PQfinish(dcsArchiveDbConn);
-		__GEN_COUT__ << "DCS_ARCHIVE DB CONNECTION CLOSED\n" << __E__;
-	}
-	if(PQstatus(dcsAlarmDbConn) == CONNECTION_OK)
-	{
-		PQfinish(dcsAlarmDbConn);
-		__GEN_COUT__ << "DCS_ALARM DB CONNECTION CLOSED\n" << __E__;
-	}
-	if(PQstatus(dcsLogDbConn) == CONNECTION_OK)
+	std::vector<std::vector<std::string>> rows;
+	char                                  time[32];
+	for(size_t i = buckets_.size(); i-- > 0;)
 	{
-		PQfinish(dcsLogDbConn);
-		__GEN_COUT__ << "DCS_LOG DB CONNECTION CLOSED\n" << __E__;
+		const Bucket& b = buckets_[i];
+		if(b.count == 0)
+			continue;
+		long long startNs = bucketStartNs(i);
+		snprintf(time, sizeof(time), "%lld.%09lld", startNs / 1000000000LL, startNs % 1000000000LL);
+		rows.push_back({time, float8ToString(b.min), float8ToString(b.max), float8ToString(b.sum / b.count), float8ToString(b.last), std::to_string(b.count)});
 	}
-}
+	return rows;
+}  // end HistoryDownsampler::toRows()
 
 //========================================================================================================================
-std::vector<std::vector<std::string>> EpicsInterface::getChannelHistory(const std::string& pvName, int startTime, int endTime)
+// Copies what memory holds of [startNs, endNs) into memory: the ring entries inside
+//	the window and the compressed chunks behind the ring, only where they are
+//	continuous. Only this copy runs under the PV's historyMutex.
+//	Returns the time from which memory is complete (LLONG_MAX if it holds nothing).
+long long EpicsInterface::copyHistoryFromMemory(PVInfo* pvInfo, long long startNs, long long endNs, MemoryHistory& memory)
 {
-	__GEN_COUT__ << "getChannelHistory() reached" << __E__;
-	std::vector<std::vector<std::string>> history;
-
-	if(mapOfPVInfo_.find(pvName) != mapOfPVInfo_.end())
-	{
-		if(dcsArchiveDbConnStatus_ == 1)
-		{
-			PGresult* res = nullptr;
-			try
-			{
-				char        buffer[1024];
-				std::string row;
-
-				// VIEW LAST 10 UPDATES
-				/*int num =*/snprintf(buffer,
-				                      sizeof(buffer),
-				                      "SELECT FLOOR(EXTRACT(EPOCH FROM smpl_time)), float_val, status.name, "
-				                      "severity.name, smpl_per FROM channel, sample, status, severity WHERE "
-				                      "channel.channel_id = sample.channel_id AND sample.severity_id = "
-				                      "severity.severity_id  AND sample.status_id = status.status_id AND "
-				                      "channel.name = \'%s\' AND smpl_time >= TO_TIMESTAMP(\'%d\') AND smpl_time < TO_TIMESTAMP(\'%d\') ORDER BY smpl_time desc",
-				                      pvName.c_str(), startTime, endTime);
-
-				res = PQexec(dcsArchiveDbConn, buffer);
-
-				if(PQresultStatus(res) != PGRES_TUPLES_OK)
-				{
-					__SS__ << "getChannelHistory(): SELECT FROM ARCHIVER DATABASE FAILED!!! PQ ERROR: " << PQresultErrorMessage(res) << __E__;
-					PQclear(res);
-					__SS_THROW__;
-				}
+	std::lock_guard<std::mutex> lock(pvInfo->historyMutex);
 
-				if(PQntuples(res) > 0)
-				{
-					/* first, print out the attribute names */
-					int nFields = PQnfields(res);
-					history.resize(PQntuples(res));
-
-					/* next, print out the rows */
-					for(int i = 0; i < PQntuples(res); i++)
-					{
-						history[i].resize(nFields);
-						for(int j = 0; j < nFields; j++)
-						{
-							history[i][j] = PQgetvalue(res, i, j);
-							row.append(PQgetvalue(res, i, j));
-							row.append(" ");
-						}
-						row.append("\n");
-					}
-					__GEN_COUT__ << "getChannelHistory(): row from select: " << row << __E__;
-					PQclear(res);
-				}
-			}
-			catch(...)
-			{
-				__SS__ << "getChannelHistory(): FAILING GETTING DATA FROM ARCHIVER DATABASE!!! PQ ERROR: " << PQresultErrorMessage(res) << __E__;
-				try	{ throw; } //one more try to printout extra info
-				catch(const std::exception &e)
-				{
-					ss << "Exception message: " << e.what();
-				}
-				catch(...){}
-				__SS_THROW__;
-			}
-		}
-		else
+	// newest samples: binary search over the time ordered ring
+	auto firstAtOrAfter = [pvInfo](long long timeNs) {
+		unsigned int lo = 0, hi = pvInfo->historySize;
+		while(lo < hi)
 		{
-			__SS__ << "getChannelHistory(): ARCHIVER DATABASE CONNECTION FAILED!!! " << __E__;
-			__SS_THROW__;
+			unsigned int mid = (lo + hi) / 2;
+			if(pvInfo->historyAt(mid).sample.timeNs() < timeNs)
+				lo = mid + 1;
+			else
+				hi = mid;
 		}
+		return lo;
+	};
+
+	long long ringFromNs = LLONG_MAX;
+	if(pvInfo->historySize)
+	{
+		ringFromNs         = pvInfo->historyAt(0).sample.timeNs();
+		unsigned int begin = firstAtOrAfter(startNs);
+		unsigned int end   = firstAtOrAfter(endNs);
+		memory.ring.reserve(end - begin);
+		for(unsigned int i = begin; i < end; ++i)
+			memory.ring.push_back(pvInfo->historyAt(i));
 	}
-	else
+
+	// older samples: compressed chunks, only where they are continuous
+	long long compressedFrom = pvInfo->compressedCoverageNs();
+	if(compressedFrom == LLONG_MAX || ringFromNs <= startNs)
+		return ringFromNs;
+
+	memory.chunksFromNs = std::max(compressedFrom, startNs);
+	memory.chunksToNs   = std::min(endNs, ringFromNs);
+	auto& chunks        = pvInfo->compressedHistory;
+	for(size_t c = 0; c < chunks.size() && chunks[c]->firstNs() < memory.chunksToNs; ++c)
+		if(chunks[c]->lastNs() >= memory.chunksFromNs)
+			memory.chunks.push_back(*chunks[c]);  // raw bytes, decoded after the lock is released
+	return std::min(ringFromNs, compressedFrom);
+}  // end copyHistoryFromMemory()
+
+//========================================================================================================================
+// Chunks are decoded one at a time, so at most one chunk's samples are held decoded
+bool MemoryHistory::forEach(const std::function<bool(const Sample& sample)>& onSample) const
+{
+	double value;
+	for(auto entry = ring.rbegin(); entry != ring.rend(); ++entry)
 	{
-		history.resize(1);
-		history[0] = {"PV Not Found", "NF", "N/a", "N/a"};
-		__GEN_COUT__ << "getChannelHistory() pvName " << pvName << " was not found!" << __E__;
-		__GEN_COUT__ << "Trying to resubscribe to " << pvName << __E__;
-		subscribe(pvName);
+		bool numeric = entry->sample.valueToDouble(value);
+		if(!onSample({entry->sample.timeNs(), numeric ? value : 0, numeric, entry->status, entry->severity, &entry->sample}))
+			return false;
 	}
 
-	return history;
-}  // end getChannelHistory()
+	std::vector<Sample> decoded;
+	for(auto chunk = chunks.rbegin(); chunk != chunks.rend(); ++chunk)
+	{
+		decoded.clear();
+		chunk->forEach([&](long long timeNs, double chunkValue, short status, short severity) {
+			if(timeNs >= chunksFromNs && timeNs < chunksToNs)
+				decoded.push_back({timeNs, chunkValue, true, status, severity, nullptr});
+		});
+		for(auto sample = decoded.rbegin(); sample != decoded.rend(); ++sample)
+			if(!onSample(*sample))
+				return false;
+	}
+	return true;
+}  // end MemoryHistory::forEach()
 
 //========================================================================================================================
 std::vector<std::vector<std::string>> EpicsInterface::getLastAlarms(const std::string& pvName)
 {
 	__GEN_COUT__ << "EpicsInterface::getLastAlarms() reached" << __E__;
+	waitForReconcile();
 	std::vector<std::vector<std::string>> alarms;
 
-	if(dcsAlarmDbConnStatus_ == 1)
+	if(PGConnectionPool::Lease db = alarmPool_.checkout())
 	{
-		PGresult* res = nullptr;
+		static const char* LAST_ALARMS_SQL =
+		    "SELECT pv.component_id, alarm_tree.name, pv.descr, pv.pv_value, status.name as status, severity.name as severity, pv.alarm_time, "
+		    "pv.enabled_ind, pv.annunciate_ind, pv.latch_ind, pv.delay, pv.filter, pv.delay_count, pv.act_global_alarm_ind "
+		    "FROM alarm_tree, pv, status, severity WHERE pv.component_id = alarm_tree.component_id AND pv.status_id = status.status_id "
+		    "AND pv.severity_id = severity.severity_id AND alarm_tree.name LIKE '%' || $1::TEXT || '%' ORDER BY pv.severity_id DESC";
+
+		PGResultPtr res(nullptr, PQclear);
 		try
 		{
-			char        buffer[1024];
-			std::string row;
-
 			// ACTION FOR ALARM DB CHANNEL TABLE
-			/*int num =*/snprintf(buffer,
-			                      sizeof(buffer),
-			                      "SELECT   pv.component_id							\
-								, alarm_tree.name							\
-								, pv.descr									\
-								, pv.pv_value								\
-								, status.name as status						\
-								, severity.name as severity					\
-								, pv.alarm_time								\
-								, pv.enabled_ind							\
-								, pv.annunciate_ind							\
-								, pv.latch_ind								\
-								, pv.delay									\
-								, pv.filter									\
-								, pv.delay_count							\
-								, pv.act_global_alarm_ind					\
-						FROM alarm_tree, pv, status, severity				\
-						WHERE	pv.component_id = alarm_tree.component_id	\
-						AND	pv.status_id = status.status_id					\
-						AND	pv.severity_id = severity.severity_id			\
-						AND	alarm_tree.name LIKE \'%%%s%%\'					\
- 						ORDER BY pv.severity_id DESC;",
-			                      pvName.c_str());
-
-			res = PQexec(dcsAlarmDbConn, buffer);
-			__COUT__ << "getLastAlarms(): SELECT pv table PQntuples(res): " << PQntuples(res) << __E__;
-
-			if(PQresultStatus(res) != PGRES_TUPLES_OK)
+			//	text result: every column is handed on as displayed by the server
+			res = db.statements().exec(db.conn(), "last_alarms", LAST_ALARMS_SQL, {pvName});
+			__COUT__ << "getLastAlarms(): SELECT pv table PQntuples(res): " << PQntuples(res.get()) << __E__;
+
+			if(PQresultStatus(res.get()) != PGRES_TUPLES_OK)
 			{
-				__SS__ << "getLastAlarms(): SELECT FROM ALARM DATABASE FAILED!!! PQ ERROR: " << PQresultErrorMessage(res) << __E__;
-				PQclear(res);
+				__SS__ << "getLastAlarms(): SELECT FROM ALARM DATABASE FAILED!!! PQ ERROR: " << PQresultErrorMessage(res.get()) << __E__;
 				__SS_THROW__;
 			}
 
-			if(PQntuples(res) > 0)
+			if(PQntuples(res.get()) > 0)
 			{
 				// UPDATE ALARMS LIST
-				int nFields = PQnfields(res);
-				alarms.resize(PQntuples(res));
+				int nFields = PQnfields(res.get());
+				alarms.resize(PQntuples(res.get()));
 
 				/* next, print out the rows */
-				for(int i = 0; i < PQntuples(res); i++)
+				for(int i = 0; i < PQntuples(res.get()); i++)
 				{
-					alarms[i].resize(nFields);
+					alarms[i].reserve(nFields);
 					for(int j = 0; j < nFields; j++)
-					{
-						alarms[i][j] = PQgetvalue(res, i, j);
-						row.append(PQgetvalue(res, i, j));
-						row.append(" ");
-					}
-					row.append("\n");
-					//__GEN_COUT__ << "getLastAlarms(): " << row << __E__;
+						alarms[i].emplace_back(PQgetvalue(res.get(), i, j), PQgetlength(res.get(), i, j));
 				}
 			}
 			else
@@ -1430,12 +3203,10 @@ std::vector<std::vector<std::string>> EpicsInterface::getLastAlarms(const std::s
 				    "N/a",
 				};
 			}
-
-			PQclear(res);
 		}
 		catch(...)
 		{
-			__SS__ << "getLastAlarms(): FAILING GETTING DATA FROM ARCHIVER DATABASE!!! PQ ERROR: " << PQresultErrorMessage(res) << __E__;
+			__SS__ << "getLastAlarms(): FAILING GETTING DATA FROM ARCHIVER DATABASE!!! PQ ERROR: " << PQresultErrorMessage(res.get()) << __E__;
 			try	{ throw; } //one more try to printout extra info
 			catch(const std::exception &e)
 			{
@@ -1457,64 +3228,42 @@ std::vector<std::vector<std::string>> EpicsInterface::getLastAlarms(const std::s
 std::vector<std::vector<std::string>> EpicsInterface::getAlarmsLog(const std::string& pvName)
 {
 	__GEN_COUT__ << "EpicsInterface::getAlarmsLog() reached" << __E__;
+	waitForReconcile();
 	std::vector<std::vector<std::string>> alarmsHistory;
 
-	if(dcsLogDbConnStatus_ == 1)
+	if(PGConnectionPool::Lease db = logPool_.checkout())
 	{
-		PGresult* res = nullptr;
+		static const char* ALARMS_LOG_SQL =
+		    "SELECT DISTINCT message.id, message.name, message_content.value, msg_property_type.name as \"status\", message.severity, "
+		    "message.datum as \"time\" FROM message, message_content, msg_property_type WHERE message.id = message_content.message_id "
+		    "AND message_content.msg_property_type_id = msg_property_type.id AND message.type = 'alarm' AND message.severity != 'OK' "
+		    "AND message.datum >= current_date -20 AND message.name LIKE '%' || $1::TEXT || '%' ORDER BY message.datum DESC";
+
+		PGResultPtr res(nullptr, PQclear);
 		try
 		{
-			char        buffer[1024];
-			std::string row;
-
 			// ACTION FOR ALARM DB CHANNEL TABLE
-			/*int num = */ snprintf(buffer,
-			                        sizeof(buffer),
-			                        "SELECT DISTINCT												\
-							  message.id												\
-							, message.name												\
-							, message_content.value										\
-							, msg_property_type.name as \"status\"						\
-							, message.severity											\
-							, message.datum	as \"time\"									\
-						FROM  	message, message_content, msg_property_type				\
-						WHERE 	message.id = message_content.message_id					\
-						AND	message_content.msg_property_type_id = msg_property_type.id \
-						AND	message.type = 'alarm'										\
-						AND	message.severity != 'OK'									\
-						AND	message.datum >= current_date -20							\
-						AND	message.name LIKE '%%%s%%'									\
-						ORDER BY message.datum DESC;",
-			                        pvName.c_str());
-
-			res = PQexec(dcsLogDbConn, buffer);
-			__COUT__ << "getAlarmsLog(): SELECT message table PQntuples(res): " << PQntuples(res) << __E__;
-
-			if(PQresultStatus(res) != PGRES_TUPLES_OK)
+			res = db.statements().exec(db.conn(), "alarms_log", ALARMS_LOG_SQL, {pvName});
+			__COUT__ << "getAlarmsLog(): SELECT message table PQntuples(res): " << PQntuples(res.get()) << __E__;
+
+			if(PQresultStatus(res.get()) != PGRES_TUPLES_OK)
 			{
-				__SS__ << "getAlarmsLog(): SELECT FROM ALARM LOG DATABASE FAILED!!! PQ ERROR: " << PQresultErrorMessage(res) << __E__;
-				PQclear(res);
+				__SS__ << "getAlarmsLog(): SELECT FROM ALARM LOG DATABASE FAILED!!! PQ ERROR: " << PQresultErrorMessage(res.get()) << __E__;
 				__SS_THROW__;
 			}
 
-			if(PQntuples(res) > 0)
+			if(PQntuples(res.get()) > 0)
 			{
 				// UPDATE ALARMS LIST
-				int nFields = PQnfields(res);
-				alarmsHistory.resize(PQntuples(res));
+				int nFields = PQnfields(res.get());
+				alarmsHistory.resize(PQntuples(res.get()));
 
 				/* next, print out the rows */
-				for(int i = 0; i < PQntuples(res); i++)
+				for(int i = 0; i < PQntuples(res.get()); i++)
 				{
-					alarmsHistory[i].resize(nFields);
+					alarmsHistory[i].reserve(nFields);
 					for(int j = 0; j < nFields; j++)
-					{
-						alarmsHistory[i][j] = PQgetvalue(res, i, j);
-						row.append(PQgetvalue(res, i, j));
-						row.append(" ");
-					}
-					row.append("\n");
-					//__GEN_COUT__ << "getAlarmsLog(): " << row << __E__;
+						alarmsHistory[i].emplace_back(PQgetvalue(res.get(), i, j), PQgetlength(res.get(), i, j));
 				}
 			}
 			else
@@ -1529,12 +3278,10 @@ std::vector<std::vector<std::string>> EpicsInterface::getAlarmsLog(const std::st
 				    "N/a",
 				};
 			}
-
-			PQclear(res);
 		}
 		catch(...)
 		{
-			__SS__ << "getAlarmsLog(): FAILING GETTING DATA FROM ARCHIVER DATABASE!!! PQ ERROR: " << PQresultErrorMessage(res) << __E__;
+			__SS__ << "getAlarmsLog(): FAILING GETTING DATA FROM ARCHIVER DATABASE!!! PQ ERROR: " << PQresultErrorMessage(res.get()) << __E__;
 			try	{ throw; } //one more try to printout extra info
 			catch(const std::exception &e)
 			{
@@ -1563,14 +3310,14 @@ std::vector<std::string> EpicsInterface::checkAlarm(const std::string& pvName, b
 {
 	__COUT__ << "checkAlarm()" << __E__;
 
-	auto pvIt = mapOfPVInfo_.find(pvName);
-	if(pvIt == mapOfPVInfo_.end())
+	PVInfo* pvInfo = findPVInfo(pvName);
+	if(!pvInfo)
 	{
 		__SS__ << "While checking for alarm status, PV name '" << pvName << "' was not found in PV list!" << __E__;
 		__SS_THROW__;
 	}
 
-	auto valueArray = getCurrentValue(pvIt->first);
+	auto valueArray = getCurrentValue(pvInfo->pvName);
 
 	std::string& time     = valueArray[0];
 	std::string& value    = valueArray[1];
@@ -1585,110 +3332,399 @@ std::vector<std::string> EpicsInterface::checkAlarm(const std::string& pvName, b
 		return std::vector<std::string>();  // empty vector, i.e. no alarm
 
 	// if here, alarm!
-	return std::vector<std::string>({pvIt->first, time, value, status, severity});
+	return std::vector<std::string>({pvInfo->pvName, time, value, status, severity});
 }  // end checkAlarm()
 
 //========================================================================================================================
 // Check Alarms from Epics
 std::vector<std::vector<std::string>> EpicsInterface::checkAlarmNotifications()
 {
+	// recompile if never done, or if PVs missing at the last compile may have been added since
+	bool stale;
+	{
+		size_t pvs;
+		{
+			std::shared_lock<std::shared_mutex> lock(mapMutex_);
+			pvs = mapOfPVInfo_.size();
+		}
+		std::lock_guard<std::mutex> lock(alarmWatchMutex_);
+		stale = !alarmWatchesCompiled_ || (alarmWatchesMissing_ && alarmWatchesMapSize_ != pvs);
+	}
+	if(stale)
+		compileAlarmWatches();
+
+	// copy the active alarms and their group, the values are formatted outside the lock
+	std::vector<std::pair<AlarmWatch, AlarmWatchGroup>> active;
+	{
+		std::lock_guard<std::mutex> lock(alarmWatchMutex_);
+		std::vector<unsigned int> order(activeAlarmWatches_);
+		std::sort(order.begin(), order.end());  // configuration order
+		active.reserve(order.size());
+		for(unsigned int i : order)
+			active.emplace_back(alarmWatches_[i], alarmWatchGroups_[alarmWatches_[i].group]);
+	}
+
 	std::vector<std::vector<std::string>> alarmReturn;
-	std::vector<std::string>              alarmRow;
-	auto                                  linkToAlarmsToNotify = getSelfNode().getNode("LinkToAlarmAlertNotificationsTable");
+	alarmReturn.reserve(active.size());
+	for(const auto& [watch, group] : active)
+	{
+		std::array<std::string, 4> valueArray = formatCurrentValue(watch.pvInfo);
+		alarmReturn.push_back(std::vector<std::string>({watch.pvInfo->pvName,
+		                                                valueArray[0],
+		                                                valueArray[1],
+		                                                valueArray[2],
+		                                                valueArray[3],
+		                                                watch.alarmName,
+		                                                group.whoToNotify,
+		                                                group.doSendEmail,
+		                                                group.name}));
+	}
+	return alarmReturn;
+}  // end checkAlarmNotifications()
 
-	if(!linkToAlarmsToNotify.isDisconnected())
+//========================================================================================================================
+// Flattens LinkToAlarmAlertNotificationsTable into alarmWatches_, so that the
+//	notification check neither walks the configuration tree nor looks up PVs.
+//	The alarm state of each watch is then kept up to date by the CA callback.
+void EpicsInterface::compileAlarmWatches()
+{
+	std::vector<AlarmWatchGroup> groups;
+	std::vector<AlarmWatch>      watches;
+	size_t                       missing = 0;
+	size_t                       pvs;
 	{
-		auto alarmsToNotifyGroups = linkToAlarmsToNotify.getChildren();
+		std::shared_lock<std::shared_mutex> lock(mapMutex_);
+		pvs = mapOfPVInfo_.size();
+	}
 
-		for(const auto& alarmsToNotifyGroup : alarmsToNotifyGroups)
+	auto linkToAlarmsToNotify = getSelfNode().getNode("LinkToAlarmAlertNotificationsTable");
+	if(!linkToAlarmsToNotify.isDisconnected())
+	{
+		for(const auto& alarmsToNotifyGroup : linkToAlarmsToNotify.getChildren())
 		{
-			__COUT__ << "checkAlarmNotifications() alarmsToNotifyGroup: " << alarmsToNotifyGroup.first << __E__;
-
 			auto alarmsToNotify = alarmsToNotifyGroup.second.getNode("LinkToAlarmsToMonitorTable");
-			if(!alarmsToNotify.isDisconnected())
+			if(alarmsToNotify.isDisconnected())
+				continue;
+
+			groups.push_back({alarmsToNotifyGroup.first,
+			                  alarmsToNotifyGroup.second.getNode("WhoToNotify").getValue<std::string>(),
+			                  alarmsToNotifyGroup.second.getNode("DoSendEmail").getValue<std::string>()});
+
+			for(const auto& alarmToNotify : alarmsToNotify.getChildren())
 			{
-				for(const auto& alarmToNotify : alarmsToNotify.getChildren())
+				PVInfo* pvInfo = findPVInfo(alarmToNotify.second.getNode("AlarmChannelName").getValue<std::string>());
+				if(!pvInfo)
 				{
-					__COUT__ << "checkAlarmNotifications() alarmToNotify: " << alarmToNotify.first << __E__;
-
-					try
-					{
-						alarmRow = checkAlarm(alarmToNotify.second.getNode("AlarmChannelName").getValue<std::string>(),
-						                      alarmToNotify.second.getNode("IgnoreMinorSeverity").getValue<bool>());
-					}
-					catch(const std::exception& e)
-					{
-						__COUT__ << "checkAlarmNotifications() alarmToNotify: " << alarmToNotify.first << " not in PVs List!!!" << __E__;
-						continue;
-					}
-					alarmRow.push_back(alarmToNotify.first);
-					alarmRow.push_back(alarmsToNotifyGroup.second.getNode("WhoToNotify").getValue<std::string>());
-					alarmRow.push_back(alarmsToNotifyGroup.second.getNode("DoSendEmail").getValue<std::string>());
-					alarmRow.push_back(alarmsToNotifyGroup.first);
-					alarmReturn.push_back(alarmRow);
+					__COUT__ << "compileAlarmWatches() alarmToNotify: " << alarmToNotify.first << " not in PVs List!!!" << __E__;
+					++missing;
+					continue;
 				}
+				watches.push_back({pvInfo,
+				                   alarmToNotify.second.getNode("IgnoreMinorSeverity").getValue<bool>(),
+				                   alarmToNotify.first,
+				                   static_cast<unsigned int>(groups.size() - 1)});
 			}
 		}
 	}
-	// __COUT__
-	// << "checkAlarmNotifications().size(): "
-	// << alarmReturn.size()
-	// << " content:";
-	// for (const auto& row : alarmReturn)
-	// 	for(const auto& s : row)
-	// 		__COUT__ << " " + s;
-	// __COUT__<< __E__;
 
-	return alarmReturn;
-}  // end checkAlarmNotifications()
+	std::lock_guard<std::mutex> lock(alarmWatchMutex_);
+	for(AlarmWatch& watch : alarmWatches_)
+	{
+		watch.pvInfo->alarmWatched = false;
+		watch.pvInfo->alarmWatches.clear();
+	}
+	alarmWatchGroups_ = std::move(groups);
+	alarmWatches_     = std::move(watches);
+	activeAlarmWatches_.clear();
+
+	for(unsigned int i = 0; i < alarmWatches_.size(); ++i)
+	{
+		AlarmWatch& watch = alarmWatches_[i];
+		watch.pvInfo->alarmWatches.push_back(i);
+		watch.pvInfo->alarmWatched = true;
+		// initial state, later updates come from the CA callback
+		setAlarmWatchActive(i, isAlarmActive(watch.pvInfo->snapshot.load(), watch.ignoreMinor));
+	}
+	alarmWatchesCompiled_ = true;
+	alarmWatchesMissing_  = missing;
+	alarmWatchesMapSize_  = pvs;
+
+	__COUT__ << "compileAlarmWatches() watching " << alarmWatches_.size() << " alarms in " << alarmWatchGroups_.size() << " notification groups, "
+	         << activeAlarmWatches_.size() << " in alarm, " << missing << " not in PVs List" << __E__;
+}  // end compileAlarmWatches()
 
 //========================================================================================================================
-// handle Alarms For FSM from Epics
-void EpicsInterface::handleAlarmsForFSM(const std::string& fsmTransitionName, ConfigurationTree linkToAlarmsToMonitor)
+// Called from the CA callback thread for PVs listed in the alarm notifications
+void EpicsInterface::updateAlarmWatches(PVInfo* pvInfo)
+{
+	std::lock_guard<std::mutex> lock(alarmWatchMutex_);
+	for(unsigned int i : pvInfo->alarmWatches)
+		setAlarmWatchActive(i, isAlarmActive(pvInfo->latest, alarmWatches_[i].ignoreMinor));
+}  // end updateAlarmWatches()
+
+//========================================================================================================================
+// Caller holds alarmWatchMutex_
+void EpicsInterface::setAlarmWatchActive(unsigned int watch, bool active)
 {
-	if(!linkToAlarmsToMonitor.isDisconnected())
+	size_t& slot = alarmWatches_[watch].activeSlot;
+	if(active && slot == SIZE_MAX)
+	{
+		slot = activeAlarmWatches_.size();
+		activeAlarmWatches_.push_back(watch);
+	}
+	else if(!active && slot != SIZE_MAX)
 	{
-		auto alarmsToMonitor = linkToAlarmsToMonitor.getChildren();
+		// move the last active watch into the freed slot
+		unsigned int last              = activeAlarmWatches_.back();
+		activeAlarmWatches_[slot]      = last;
+		alarmWatches_[last].activeSlot = slot;
+		activeAlarmWatches_.pop_back();
+		slot = SIZE_MAX;
+	}
+}  // end setAlarmWatchActive()
+
+//========================================================================================================================
+// Same rule as checkAlarm(): anything but NO_ALARM is an alarm, including a
+//	disconnected PV, and MINOR is ignored if requested
+bool EpicsInterface::isAlarmActive(const PVSnapshot& snapshot, bool ignoreMinor)
+{
+	if(snapshot.sample.type == PVSample::ValueType::EMPTY)
+		return true;
+	if(snapshot.status < 0 || snapshot.status >= ALARM_NSTATUS || snapshot.severity < 0 || snapshot.severity >= ALARM_NSEV)
+		return true;  // reported as INVALID
+	return !(snapshot.severity == epicsSevNone || (ignoreMinor && snapshot.severity == epicsSevMinor));
+}  // end isAlarmActive()
 
-		__SS__;
+//========================================================================================================================
+// Resolves the LinkTo<Transition>AlarmsToMonitorTable links once, so that a
+//	transition, and the monitor thread while running, only read the PV snapshots.
+void EpicsInterface::compileFSMAlarmSets()
+{
+	static const std::array<std::pair<const char*, const char*>, 7> FSM_ALARM_LINKS = {{
+	    {"configure", "LinkToConfigureAlarmsToMonitorTable"},
+	    {"halt", "LinkToHaltAlarmsToMonitorTable"},
+	    {"pause", "LinkToPauseAlarmsToMonitorTable"},
+	    {"resume", "LinkToResumeAlarmsToMonitorTable"},
+	    {"start", "LinkToStartAlarmsToMonitorTable"},
+	    {"stop", "LinkToStopAlarmsToMonitorTable"},
+	    {"running", "LinkToRunningAlarmsToMonitorTable"},
+	}};
+
+	std::map<std::string, FSMAlarmSet> sets;
+	size_t                             missing = 0;
+	size_t                             pvs;
+	{
+		std::shared_lock<std::shared_mutex> lock(mapMutex_);
+		pvs = mapOfPVInfo_.size();
+	}
 
-		ss << "During '" << fsmTransitionName << "'... Alarms monitoring (count=" << alarmsToMonitor.size() << "):" << __E__;
-		for(const auto& alarmToMonitor : alarmsToMonitor)
-			ss << "\t" << alarmToMonitor.first << __E__;
-		ss << __E__;
+	for(const auto& [fsmTransitionName, linkName] : FSM_ALARM_LINKS)
+	{
+		FSMAlarmSet& set                   = sets[fsmTransitionName];
+		auto         linkToAlarmsToMonitor = getSelfNode().getNode(linkName);
+		set.disconnected                   = linkToAlarmsToMonitor.isDisconnected();
+		if(set.disconnected)
+			continue;
 
-		unsigned foundCount = 0;
-		for(const auto& alarmToMonitor : alarmsToMonitor)
+		for(const auto& alarmToMonitor : linkToAlarmsToMonitor.getChildren())
 		{
-			std::vector<std::string> alarmReturn = checkAlarm(alarmToMonitor.second.getNode("AlarmChannelName").getValue<std::string>(),
-			                                                  alarmToMonitor.second.getNode("IgnoreMinorSeverity").getValue<bool>());
-
-			if(alarmReturn.size())
+			set.alarmNames.push_back(alarmToMonitor.first);
+			std::string pvName = alarmToMonitor.second.getNode("AlarmChannelName").getValue<std::string>();
+			PVInfo*     pvInfo = findPVInfo(pvName);
+			if(!pvInfo)
 			{
-				ss << "Found alarm for channel '" << alarmReturn[0] << "' = {"
-				   << "time=" << alarmReturn[1] << ", value=" << alarmReturn[2] << ", status=" << alarmReturn[3] << ", severity=" << alarmReturn[4] << "}!"
-				   << __E__;
-				++foundCount;
+				set.missingChannels.push_back(pvName);
+				++missing;
+				continue;
 			}
+			set.alarms.push_back({pvInfo, alarmToMonitor.second.getNode("IgnoreMinorSeverity").getValue<bool>()});
 		}
-		if(foundCount)
+	}
+
+	std::unordered_map<PVInfo*, bool> runningAlarmPVs;
+	for(const FSMAlarm& alarm : sets["running"].alarms)
+	{
+		auto it = runningAlarmPVs.emplace(alarm.pvInfo, alarm.ignoreMinor).first;
+		it->second &= alarm.ignoreMinor;  // listed twice: MINOR counts if either record wants it
+	}
+
+	std::lock_guard<std::mutex> lock(fsmAlarmMutex_);
+	fsmAlarmSets_         = std::move(sets);
+	runningAlarmPVs_      = std::move(runningAlarmPVs);
+	fsmAlarmSetsCompiled_ = true;
+	fsmAlarmSetsMissing_  = missing;
+	fsmAlarmSetsMapSize_  = pvs;
+}  // end compileFSMAlarmSets()
+
+//========================================================================================================================
+// handle Alarms For FSM from Epics
+void EpicsInterface::handleAlarmsForFSM(const std::string& fsmTransitionName)
+{
+	// recompile if never done, or if PVs missing at the last compile may have been added since
+	bool stale;
+	{
+		size_t pvs;
 		{
-			ss << __E__ << "Total alarms found = " << foundCount << __E__;
-			__SS_THROW__;
+			std::shared_lock<std::shared_mutex> lock(mapMutex_);
+			pvs = mapOfPVInfo_.size();
 		}
-		__COUT__ << ss.str();
+		std::lock_guard<std::mutex> lock(fsmAlarmMutex_);
+		stale = !fsmAlarmSetsCompiled_ || (fsmAlarmSetsMissing_ && fsmAlarmSetsMapSize_ != pvs);
 	}
-	else
+	if(stale)
+		compileFSMAlarmSets();
+
+	FSMAlarmSet alarmSet;
+	{
+		std::lock_guard<std::mutex> lock(fsmAlarmMutex_);
+		alarmSet = fsmAlarmSets_[fsmTransitionName];
+	}
+
+	if(alarmSet.disconnected)
+	{
 		__COUT__ << "Disconnected alarms to monitor!" << __E__;
+		return;
+	}
+
+	if(alarmSet.missingChannels.size())
+	{
+		__SS__ << "While checking for alarm status, PV name '" << alarmSet.missingChannels[0] << "' was not found in PV list!" << __E__;
+		__SS_THROW__;
+	}
+
+	__SS__;
+
+	ss << "During '" << fsmTransitionName << "'... Alarms monitoring (count=" << alarmSet.alarmNames.size() << "):" << __E__;
+	for(const auto& alarmName : alarmSet.alarmNames)
+		ss << "\t" << alarmName << __E__;
+	ss << __E__;
 
+	unsigned foundCount = 0;
+	for(const FSMAlarm& alarm : alarmSet.alarms)
+	{
+		if(!isAlarmActive(alarm.pvInfo->snapshot.load(), alarm.ignoreMinor))
+			continue;
+
+		std::array<std::string, 4> valueArray = formatCurrentValue(alarm.pvInfo);
+		ss << "Found alarm for channel '" << alarm.pvInfo->pvName << "' = {"
+		   << "time=" << valueArray[0] << ", value=" << valueArray[1] << ", status=" << valueArray[2] << ", severity=" << valueArray[3] << "}!" << __E__;
+		++foundCount;
+	}
+	if(foundCount)
+	{
+		ss << __E__ << "Total alarms found = " << foundCount << __E__;
+		__SS_THROW__;
+	}
+	__COUT__ << ss.str();
 }  // end handleAlarmsForFSM()
 
+//========================================================================================================================
+// The running set is checked as a whole when running starts, afterwards only
+//	when the monitor thread saw one of its PVs go into alarm. The wait is bounded
+//	so that the workloop still returns to the FSM regularly.
+bool EpicsInterface::running()
+{
+	bool check = runningFullCheck_.exchange(false);
+	if(!check)
+	{
+		std::unique_lock<std::mutex> lock(alarmMonitorMutex_);
+		check                = runningAlarmCV_.wait_for(lock, std::chrono::seconds(1), [this]() { return runningAlarmPending_; });
+		runningAlarmPending_ = false;
+	}
+	if(check)
+		handleAlarmsForFSM("running");
+	return true;
+}  // end running()
+
+//========================================================================================================================
+// Called from the CA callback thread when the alarm state of a PV changed,
+//	after the new state is published in its snapshot
+void EpicsInterface::postAlarmEvent(PVInfo* pvInfo)
+{
+	if(!alarmEvents_.push(&pvInfo->alarmEvent))
+		return;  // still queued, the monitor thread will read the latest snapshot
+	{
+		std::lock_guard<std::mutex> lock(alarmMonitorMutex_);
+		alarmEventsPosted_ = true;
+	}
+	alarmMonitorCV_.notify_one();
+}  // end postAlarmEvent()
+
+//========================================================================================================================
+// Evaluates alarm transitions against the running set as they come in,
+//	instead of polling every PV of the set each second
+void EpicsInterface::startAlarmMonitorThread()
+{
+	alarmMonitorStop_   = false;
+	alarmMonitorThread_ = std::thread([this]() {
+		std::unique_lock<std::mutex> lock(alarmMonitorMutex_);
+		while(true)
+		{
+			alarmMonitorCV_.wait(lock, [this]() { return alarmMonitorStop_ || alarmEventsPosted_; });
+			if(alarmMonitorStop_)
+				return;
+			alarmEventsPosted_ = false;
+
+			lock.unlock();
+			bool found = drainAlarmEvents();
+			lock.lock();
+
+			if(found)
+			{
+				runningAlarmPending_ = true;
+				runningAlarmCV_.notify_all();
+			}
+		}
+	});
+}  // end startAlarmMonitorThread()
+
+//========================================================================================================================
+void EpicsInterface::stopAlarmMonitorThread()
+{
+	if(!alarmMonitorThread_.joinable())
+		return;
+	{
+		std::lock_guard<std::mutex> lock(alarmMonitorMutex_);
+		alarmMonitorStop_ = true;
+	}
+	alarmMonitorCV_.notify_all();
+	alarmMonitorThread_.join();
+}  // end stopAlarmMonitorThread()
+
+//========================================================================================================================
+// Monitor thread only. Returns true if a PV of the running set is in alarm.
+bool EpicsInterface::drainAlarmEvents()
+{
+	bool found = false;
+	while(true)
+	{
+		AlarmEventNode* node = alarmEvents_.pop();
+		if(!node)
+		{
+			if(alarmEvents_.drained())
+				break;
+			std::this_thread::yield();  // a producer is between its exchange and its store
+			continue;
+		}
+		PVInfo* pvInfo = node->pvInfo;
+		node->queued.store(false, std::memory_order_release);  // later transitions are posted again
+
+		std::lock_guard<std::mutex> lock(fsmAlarmMutex_);
+		auto                        it = runningAlarmPVs_.find(pvInfo);
+		if(it != runningAlarmPVs_.end() && isAlarmActive(pvInfo->snapshot.load(), it->second))
+			found = true;
+	}
+	return found;
+}  // end drainAlarmEvents()
+
 //========================================================================================================================
 // Configure override for Epics
 void EpicsInterface::configure()
 {
+	waitForReconcile();
 
-	handleAlarmsForFSM("configure", getSelfNode().getNode("LinkToConfigureAlarmsToMonitorTable"));
+	compileFSMAlarmSets();  // the tables may have changed since the last configure
+	handleAlarmsForFSM("configure");
 
 	__COUT__ << "configure(): Preparing EPICS for PVs..." << __E__;
 
@@ -1719,270 +3755,450 @@ void EpicsInterface::configure()
 			std::vector<std::pair<std::string, std::vector<std::string>>> channels;
 			slowControlsTable->getSlowControlsChannelList(channels);
 
+			std::vector<ArchiveChannelConfig> archiveChannels;
+			archiveChannels.reserve(channels.size());
 			for(const auto& channel : channels)
 			{
-				std::string pvName       = channel.first;
-				std::string descr        = channel.second.at(0);
-				int         grp_id       = 4;
-				int         smpl_mode_id = 1;
-				double      smpl_val     = 0.;
-				double      smpl_per     = 60.;
-				int         retent_id    = 9999;
-				double      retent_val   = 9999.;
-
-				double      low_disp_rng   = 0.;
-				double      high_disp_rng  = 0.;
-				double      low_warn_lmt   = atof(channel.second.at(1).c_str());
-				double      high_warn_lmt  = atof(channel.second.at(2).c_str());
-				double      low_alarm_lmt  = atof(channel.second.at(3).c_str());
-				double      high_alarm_lmt = atof(channel.second.at(4).c_str());
-				int         prec           = atoi(channel.second.at(5).c_str());
-				std::string unit           = channel.second.at(6);
-
-				if(!checkIfPVExists(pvName))
+				ArchiveChannelConfig config;
+				config.name         = channel.first;
+				config.descr        = channel.second.at(0);
+				config.lowWarnLmt   = atof(channel.second.at(1).c_str());
+				config.highWarnLmt  = atof(channel.second.at(2).c_str());
+				config.lowAlarmLmt  = atof(channel.second.at(3).c_str());
+				config.highAlarmLmt = atof(channel.second.at(4).c_str());
+				config.prec         = atoi(channel.second.at(5).c_str());
+				config.unit         = channel.second.at(6);
+				archiveChannels.push_back(config);
+
+				if(!checkIfPVExists(config.name))
 				{
-					mapOfPVInfo_[pvName] = new PVInfo(DBR_STRING);
-					__COUT__ << "configure(): new PV '" << pvName << "' found! Now subscribing" << __E__;
-					subscribe(pvName);
+					addPVInfo(config.name);
+					__COUT__ << "configure(): new PV '" << config.name << "' found! Now subscribing" << __E__;
+					subscribe(config.name);
 				}
+			}
 
-				if(dcsArchiveDbConnStatus_ == 1)
-				{
-					PGresult* res = nullptr;
-					char      buffer[1024];
-					try
-					{
-						// ACTION FOR DB ARCHIVER CHANNEL TABLE
-						snprintf(buffer, sizeof(buffer), "SELECT name FROM channel WHERE name = '%s';", pvName.c_str());
-
-						res = PQexec(dcsArchiveDbConn, buffer);
-						__COUT__ << "configure(): SELECT channel table PQntuples(res): " << PQntuples(res) << __E__;
-
-						if(PQresultStatus(res) != PGRES_TUPLES_OK)
-						{
-							__SS__ << "configure(): SELECT FOR DATABASE CHANNEL TABLE FAILED!!! PV Name: " << pvName
-							       << " PQ ERROR: " << PQresultErrorMessage(res) << __E__;
-							PQclear(res);
-							__SS_THROW__;
-						}
-
-						if(PQntuples(res) > 0)
-						{
-							// UPDATE DB ARCHIVER CHANNEL TABLE
-							PQclear(res);
-							__COUT__ << "configure(): Updating PV: " << pvName << " in the Archiver Database channel table" << __E__;
-							snprintf(buffer,
-							         sizeof(buffer),
-							         "UPDATE channel SET					\
-															  grp_id=%d			\
-															, smpl_mode_id=%d	\
-															, smpl_val=%f		\
-															, smpl_per=%f		\
-															, retent_id=%d		\
-															, retent_val=%f		\
-											WHERE name = '%s';",
-							         grp_id,
-							         smpl_mode_id,
-							         smpl_val,
-							         smpl_per,
-							         retent_id,
-							         retent_val,
-							         pvName.c_str());
-							//__COUT__ << "configure(): channel update select: " << buffer << __E__;
-
-							res = PQexec(dcsArchiveDbConn, buffer);
-
-							if(PQresultStatus(res) != PGRES_COMMAND_OK)
-							{
-								__SS__ << "configure(): CHANNEL UPDATE INTO DATABASE CHANNEL TABLE FAILED!!! PV Name: " << pvName
-								       << " PQ ERROR: " << PQresultErrorMessage(res) << __E__;
-								PQclear(res);
-								__SS_THROW__;
-							}
-							PQclear(res);
-						}
-						else
-						{
-							// INSERT INTO DB ARCHIVER CHANNEL TABLE
-							PQclear(res);
-							__COUT__ << "configure(): Writing new PV in the Archiver Database channel table" << __E__;
-							snprintf(buffer,
-							         sizeof(buffer),
-							         "INSERT INTO channel(					\
-												  name				\
-												, descr				\
-												, grp_id			\
-												, smpl_mode_id		\
-												, smpl_val			\
-												, smpl_per			\
-												, retent_id			\
-												, retent_val)		\
-							VALUES ('%s', '%s', %d, %d, %f, %f, %d, %f);",
-							         pvName.c_str(),
-							         descr.c_str(),
-							         grp_id,
-							         smpl_mode_id,
-							         smpl_val,
-							         smpl_per,
-							         retent_id,
-							         retent_val);
-
-							res = PQexec(dcsArchiveDbConn, buffer);
-							if(PQresultStatus(res) != PGRES_COMMAND_OK)
-							{
-								__SS__ << "configure(): CHANNEL INSERT INTO DATABASE CHANNEL TABLE FAILED!!! PV Name: " << pvName
-								       << " PQ ERROR: " << PQresultErrorMessage(res) << __E__;
-								PQclear(res);
-								__SS_THROW__;
-							}
-							PQclear(res);
-						}
-
-						// ACTION FOR DB ARCHIVER NUM_METADATA TABLE
-						snprintf(
-						    buffer,
-						    sizeof(buffer),
-						    "SELECT channel.channel_id FROM channel, num_metadata WHERE channel.channel_id = num_metadata.channel_id AND channel.name = '%s';",
-						    pvName.c_str());
-
-						res = PQexec(dcsArchiveDbConn, buffer);
-						__COUT__ << "configure(): SELECT num_metadata table PQntuples(res): " << PQntuples(res) << __E__;
-
-						if(PQresultStatus(res) != PGRES_TUPLES_OK)
-						{
-							__SS__ << "configure(): SELECT FOR DATABASE NUM_METADATA TABLE FAILED!!! PV Name: " << pvName
-							       << " PQ ERROR: " << PQresultErrorMessage(res) << __E__;
-							PQclear(res);
-							__SS_THROW__;
-						}
-
-						if(PQntuples(res) > 0)
-						{
-							// UPDATE DB ARCHIVER NUM_METADATA TABLE
-							std::string channel_id = PQgetvalue(res, 0, 0);
-							__COUT__ << "configure(): Updating PV: " << pvName << " channel_id: " << channel_id
-							         << " in the Archiver Database num_metadata table" << __E__;
-							PQclear(res);
-							snprintf(buffer,
-							         sizeof(buffer),
-							         "UPDATE num_metadata SET					\
-												  low_disp_rng=%f		\
-												, high_disp_rng=%f		\
-												, low_warn_lmt=%f		\
-												, high_warn_lmt=%f		\
-												, low_alarm_lmt=%f		\
-												, high_alarm_lmt=%f		\
-												, prec=%d				\
-												, unit='%s'				\
-							WHERE channel_id='%s';",
-							         low_disp_rng,
-							         high_disp_rng,
-							         low_warn_lmt,
-							         high_warn_lmt,
-							         low_alarm_lmt,
-							         high_alarm_lmt,
-							         prec,
-							         unit.c_str(),
-							         channel_id.c_str());
-
-							res = PQexec(dcsArchiveDbConn, buffer);
-							if(PQresultStatus(res) != PGRES_COMMAND_OK)
-							{
-								__SS__ << "configure(): CHANNEL UPDATE INTO DATABASE NUM_METADATA TABLE FAILED!!! PV Name(channel_id): " << pvName << " "
-								       << channel_id << " PQ ERROR: " << PQresultErrorMessage(res) << __E__;
-								PQclear(res);
-								__SS_THROW__;
-							}
-							PQclear(res);
-						}
-						else
-						{
-							// INSERT INTO DB ARCHIVER NUM_METADATA TABLE
-							snprintf(buffer, sizeof(buffer), "SELECT channel_id FROM channel WHERE name = '%s';", pvName.c_str());
-
-							res = PQexec(dcsArchiveDbConn, buffer);
-							__COUT__ << "configure(): SELECT channel table to check channel_id for num_metadata table. PQntuples(res): " << PQntuples(res)
-							         << __E__;
-
-							if(PQresultStatus(res) != PGRES_TUPLES_OK)
-							{
-								__SS__ << "configure(): SELECT TO DATABASE CHANNEL TABLE FOR NUM_MATADATA TABLE FAILED!!! PV Name: " << pvName
-								       << " PQ ERROR: " << PQresultErrorMessage(res) << __E__;
-								PQclear(res);
-								__SS_THROW__;
-							}
-
-							if(PQntuples(res) > 0)
-							{
-								std::string channel_id = PQgetvalue(res, 0, 0);
-								__COUT__ << "configure(): Writing new PV in the Archiver Database num_metadata table" << __E__;
-								PQclear(res);
-
-								snprintf(buffer,
-								         sizeof(buffer),
-								         "INSERT INTO num_metadata(			\
-												  channel_id		\
-												, low_disp_rng		\
-												, high_disp_rng		\
-												, low_warn_lmt		\
-												, high_warn_lmt		\
-												, low_alarm_lmt		\
-												, high_alarm_lmt	\
-												, prec				\
-												, unit)				\
-												VALUES ('%s',%f,%f,%f,%f,%f,%f,%d,'%s');",
-								         channel_id.c_str(),
-								         low_disp_rng,
-								         high_disp_rng,
-								         low_warn_lmt,
-								         high_warn_lmt,
-								         low_alarm_lmt,
-								         high_alarm_lmt,
-								         prec,
-								         unit.c_str());
-
-								res = PQexec(dcsArchiveDbConn, buffer);
-								if(PQresultStatus(res) != PGRES_COMMAND_OK)
-								{
-									__SS__ << "configure(): CHANNEL INSERT INTO DATABASE NUM_METADATA TABLE FAILED!!! PV Name: " << pvName
-									       << " PQ ERROR: " << PQresultErrorMessage(res) << __E__;
-									PQclear(res);
-									__SS_THROW__;
-								}
-								PQclear(res);
-							}
-							else
-							{
-								__SS__ << "configure(): CHANNEL INSERT INTO DATABASE NUM_METADATA TABLE FAILED!!! PV Name: " << pvName
-								       << " NOT RECOGNIZED IN CHANNEL TABLE" << __E__;
-								PQclear(res);
-								__SS_THROW__;
-							}
-						}
-					}
-					catch(...)
-					{
-						__SS__ << "configure(): CHANNEL INSERT OR UPDATE INTO DATABASE FAILED!!! "
-						       << " PQ ERROR: " << PQresultErrorMessage(res) << __E__;
-						try	{ throw; } //one more try to printout extra info
-						catch(const std::exception &e)
-						{
-							ss << "Exception message: " << e.what();
-						}
-						catch(...){}
-						__SS_THROW__;
-					}
-				}
-				else
-				{
-					// RAR 21-Dec-2022: remove exception throwing for cases when db connection not expected
-					__COUT_INFO__ << "configure(): Archiver Database connection does not exist, so skipping channel update." << __E__;
-					// __SS_THROW__;
-					break;
-				}
-			}  // end channel name loop
+			PGConnectionPool::Lease db = archivePool_.checkout();  // one connection for the whole list
+			if(!db)
+			{
+				// RAR 21-Dec-2022: remove exception throwing for cases when db connection not expected
+				__COUT_INFO__ << "configure(): Archiver Database connection does not exist, so skipping channel update." << __E__;
+				// __SS_THROW__;
+				continue;
+			}
+
+			// only channels added or changed since the last configure are written
+			std::unordered_map<std::string, uint64_t> known = loadChannelFingerprints(db, slowControlsChannelsSourceTable);
+			std::vector<ArchiveChannelConfig>         changed;
+			std::unordered_set<std::string>           listed;
+			for(const auto& config : archiveChannels)
+			{
+				auto it = known.find(config.name);
+				if(it == known.end() || it->second != config.fingerprint())
+					changed.push_back(config);
+				listed.insert(config.name);
+			}
+			std::vector<std::string> removed;
+			for(const auto& fingerprint : known)
+				if(listed.find(fingerprint.first) == listed.end())
+					removed.push_back(fingerprint.first);
+			__COUT__ << "configure(): " << slowControlsChannelsSourceTable << ": " << changed.size() << " channels added or changed, " << removed.size()
+			         << " removed, " << archiveChannels.size() - changed.size() << " unchanged" << __E__;
+
+			// the whole list in one transaction; channel by channel, pipelined, only if that is refused
+			if(changed.size() && !writeArchiveChannels(db, changed))
+				writeArchiveChannelsPipelined(db, changed);
+			if(changed.size() || removed.size())
+				saveChannelFingerprints(db, slowControlsChannelsSourceTable, changed, removed);
 		}
 	}  // end slowControlsChannelsSourceTables loop
+
+	compileAlarmWatches();
+	compileFSMAlarmSets();  // resolve the PVs subscribed above
 }  // end configure()
 
+//========================================================================================================================
+// Writes all channels to the archiver's channel and num_metadata tables in one
+//	transaction: COPY into a temporary table, then one INSERT ... ON CONFLICT per table.
+//	The round trips no longer grow with the number of channels. Returns false, with
+//	everything rolled back, if the server refuses, e.g. a schema without the unique
+//	constraints on channel.name and num_metadata.channel_id.
+bool EpicsInterface::writeArchiveChannels(PGConnectionPool::Lease& db, const std::vector<ArchiveChannelConfig>& channels)
+{
+	static const char* CREATE_SQL =
+	    "CREATE TEMP TABLE configure_channels (ord INT, name TEXT, descr TEXT, grp_id INT, smpl_mode_id INT, smpl_val FLOAT8, smpl_per FLOAT8, "
+	    "retent_id INT, retent_val FLOAT8, low_disp_rng FLOAT8, high_disp_rng FLOAT8, low_warn_lmt FLOAT8, high_warn_lmt FLOAT8, "
+	    "low_alarm_lmt FLOAT8, high_alarm_lmt FLOAT8, prec INT, unit TEXT) ON COMMIT DROP";
+	// the last entry of a name wins, as when writing channel by channel; descr is only set for new channels
+	static const char* CHANNEL_UPSERT_SQL =
+	    "INSERT INTO channel(name, descr, grp_id, smpl_mode_id, smpl_val, smpl_per, retent_id, retent_val) "
+	    "SELECT DISTINCT ON (name) name, descr, grp_id, smpl_mode_id, smpl_val, smpl_per, retent_id, retent_val FROM configure_channels "
+	    "ORDER BY name, ord DESC ON CONFLICT (name) DO UPDATE SET grp_id = EXCLUDED.grp_id, smpl_mode_id = EXCLUDED.smpl_mode_id, "
+	    "smpl_val = EXCLUDED.smpl_val, smpl_per = EXCLUDED.smpl_per, retent_id = EXCLUDED.retent_id, retent_val = EXCLUDED.retent_val";
+	static const char* METADATA_UPSERT_SQL =
+	    "INSERT INTO num_metadata(channel_id, low_disp_rng, high_disp_rng, low_warn_lmt, high_warn_lmt, low_alarm_lmt, high_alarm_lmt, prec, unit) "
+	    "SELECT DISTINCT ON (channel.channel_id) channel.channel_id, c.low_disp_rng, c.high_disp_rng, c.low_warn_lmt, c.high_warn_lmt, "
+	    "c.low_alarm_lmt, c.high_alarm_lmt, c.prec, c.unit FROM configure_channels c JOIN channel ON channel.name = c.name "
+	    "ORDER BY channel.channel_id, c.ord DESC ON CONFLICT (channel_id) DO UPDATE SET low_disp_rng = EXCLUDED.low_disp_rng, "
+	    "high_disp_rng = EXCLUDED.high_disp_rng, low_warn_lmt = EXCLUDED.low_warn_lmt, high_warn_lmt = EXCLUDED.high_warn_lmt, "
+	    "low_alarm_lmt = EXCLUDED.low_alarm_lmt, high_alarm_lmt = EXCLUDED.high_alarm_lmt, prec = EXCLUDED.prec, unit = EXCLUDED.unit";
+	const size_t COPY_CHUNK_BYTES = 1 << 20;
+
+	auto        startTime = std::chrono::steady_clock::now();
+	PGconn*     conn      = db.conn();
+	std::string error;
+	std::string upserted;
+	auto        run = [conn, &error](const char* sql, ExecStatusType expected) {
+		if(error.size())
+			return std::string();
+		PGResultPtr res(PQexec(conn, sql), PQclear);
+		if(PQresultStatus(res.get()) != expected)
+			error = PQresultErrorMessage(res.get());
+		return std::string(PQcmdTuples(res.get()));
+	};
+
+	run("BEGIN", PGRES_COMMAND_OK);
+	run(CREATE_SQL, PGRES_COMMAND_OK);
+	run("COPY configure_channels FROM STDIN", PGRES_COPY_IN);
+	if(error.empty())
+	{
+		// COPY text format: tab separated, backslash escapes
+		auto field = [](std::string& line, const std::string& value) {
+			for(char ch : value)
+			{
+				if(ch == '\\')
+					line += "\\\\";
+				else if(ch == '\t')
+					line += "\\t";
+				else if(ch == '\n')
+					line += "\\n";
+				else if(ch == '\r')
+					line += "\\r";
+				else
+					line += ch;
+			}
+		};
+
+		std::string buffer;
+		bool        sent = true;
+		for(size_t i = 0; i < channels.size() && sent; ++i)
+		{
+			const ArchiveChannelConfig& channel = channels[i];
+			buffer += std::to_string(i) + '\t';
+			field(buffer, channel.name);
+			buffer += '\t';
+			field(buffer, channel.descr);
+			for(const std::string& number : {std::to_string(channel.grpID),
+			                                 std::to_string(channel.smplModeID),
+			                                 float8ToString(channel.smplVal),
+			                                 float8ToString(channel.smplPer),
+			                                 std::to_string(channel.retentID),
+			                                 float8ToString(channel.retentVal),
+			                                 float8ToString(channel.lowDispRng),
+			                                 float8ToString(channel.highDispRng),
+			                                 float8ToString(channel.lowWarnLmt),
+			                                 float8ToString(channel.highWarnLmt),
+			                                 float8ToString(channel.lowAlarmLmt),
+			                                 float8ToString(channel.highAlarmLmt),
+			                                 std::to_string(channel.prec)})
+				buffer += '\t' + number;
+			buffer += '\t';
+			field(buffer, channel.unit);
+			buffer += '\n';
+
+			if(buffer.size() >= COPY_CHUNK_BYTES || i + 1 == channels.size())
+			{
+				sent = PQputCopyData(conn, buffer.data(), buffer.size()) == 1;
+				buffer.clear();
+			}
+		}
+		if(PQputCopyEnd(conn, sent ? nullptr : "configure() could not send all rows") != 1 || !sent)
+			error = PQerrorMessage(conn);
+		for(PGResultPtr res(PQgetResult(conn), PQclear); res; res.reset(PQgetResult(conn)))
+			if(PQresultStatus(res.get()) != PGRES_COMMAND_OK && error.empty())
+				error = PQresultErrorMessage(res.get());
+	}
+	run(CHANNEL_UPSERT_SQL, PGRES_COMMAND_OK);
+	upserted = run(METADATA_UPSERT_SQL, PGRES_COMMAND_OK);
+	run("COMMIT", PGRES_COMMAND_OK);
+
+	if(error.size())
+	{
+		PGResultPtr(PQexec(conn, "ROLLBACK"), PQclear);
+		__COUT__ << "configure(): batched channel update refused, writing channel by channel instead. PQ ERROR: " << error << __E__;
+		return false;
+	}
+	__COUT__ << "configure(): wrote " << channels.size() << " channels (" << upserted << " with metadata) to the Archiver Database in one transaction in "
+	         << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count() << " ms" << __E__;
+	return true;
+}  // end writeArchiveChannels()
+
+//========================================================================================================================
+// Fallback of writeArchiveChannels(): four statements per channel that do not depend on
+//	each other's results (update, then insert if still missing), streamed through a
+//	PGPipeline so the link latency is paid once per window instead of once per statement.
+//	Each channel succeeds or fails on its own; failures are reported together at the end.
+void EpicsInterface::writeArchiveChannelsPipelined(PGConnectionPool::Lease& db, const std::vector<ArchiveChannelConfig>& channels)
+{
+	static const char* CHANNEL_UPDATE_SQL =
+	    "UPDATE channel SET grp_id=$2, smpl_mode_id=$3, smpl_val=$4, smpl_per=$5, retent_id=$6, retent_val=$7 WHERE name = $1";
+	static const char* CHANNEL_INSERT_SQL =
+	    "INSERT INTO channel(name, descr, grp_id, smpl_mode_id, smpl_val, smpl_per, retent_id, retent_val) "
+	    "SELECT $1::TEXT, $2::TEXT, $3::INT, $4::INT, $5::FLOAT8, $6::FLOAT8, $7::INT, $8::FLOAT8 "
+	    "WHERE NOT EXISTS (SELECT 1 FROM channel WHERE name = $1::TEXT)";
+	static const char* METADATA_UPDATE_SQL =
+	    "UPDATE num_metadata SET low_disp_rng=$2, high_disp_rng=$3, low_warn_lmt=$4, high_warn_lmt=$5, low_alarm_lmt=$6, high_alarm_lmt=$7, "
+	    "prec=$8, unit=$9 FROM channel WHERE num_metadata.channel_id = channel.channel_id AND channel.name = $1";
+	static const char* METADATA_INSERT_SQL =
+	    "INSERT INTO num_metadata(channel_id, low_disp_rng, high_disp_rng, low_warn_lmt, high_warn_lmt, low_alarm_lmt, high_alarm_lmt, prec, unit) "
+	    "SELECT channel.channel_id, $2::FLOAT8, $3::FLOAT8, $4::FLOAT8, $5::FLOAT8, $6::FLOAT8, $7::FLOAT8, $8::INT, $9::TEXT FROM channel "
+	    "WHERE channel.name = $1::TEXT AND NOT EXISTS (SELECT 1 FROM num_metadata WHERE num_metadata.channel_id = channel.channel_id)";
+
+	auto       startTime = std::chrono::steady_clock::now();
+	PGPipeline pipeline(db.conn());
+	for(const ArchiveChannelConfig& channel : channels)
+	{
+		pipeline.queue(channel.name,
+		               CHANNEL_UPDATE_SQL,
+		               {channel.name,
+		                std::to_string(channel.grpID),
+		                std::to_string(channel.smplModeID),
+		                float8ToString(channel.smplVal),
+		                float8ToString(channel.smplPer),
+		                std::to_string(channel.retentID),
+		                float8ToString(channel.retentVal)});
+		pipeline.queue(channel.name,
+		               CHANNEL_INSERT_SQL,
+		               {channel.name,
+		                channel.descr,
+		                std::to_string(channel.grpID),
+		                std::to_string(channel.smplModeID),
+		                float8ToString(channel.smplVal),
+		                float8ToString(channel.smplPer),
+		                std::to_string(channel.retentID),
+		                float8ToString(channel.retentVal)});
+
+		std::vector<std::string> metadata = {channel.name,
+		                                     float8ToString(channel.lowDispRng),
+		                                     float8ToString(channel.highDispRng),
+		                                     float8ToString(channel.lowWarnLmt),
+		                                     float8ToString(channel.highWarnLmt),
+		                                     float8ToString(channel.lowAlarmLmt),
+		                                     float8ToString(channel.highAlarmLmt),
+		                                     std::to_string(channel.prec),
+		                                     channel.unit};
+		pipeline.queue(channel.name, METADATA_UPDATE_SQL, std::vector<std::string>(metadata));
+		pipeline.queue(channel.name, METADATA_INSERT_SQL, std::move(metadata));
+	}
+
+	std::vector<std::pair<std::string, std::string>> failed = pipeline.run();
+	__COUT__ << "configure(): wrote " << channels.size() - failed.size() << " of " << channels.size() << " channels to the Archiver Database in "
+	         << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count() << " ms" << __E__;
+	if(failed.size())
+	{
+		__SS__ << "configure(): CHANNEL INSERT OR UPDATE INTO DATABASE FAILED for " << failed.size() << " of " << channels.size() << " channels!!! " << __E__;
+		for(size_t i = 0; i < failed.size() && i < 20; ++i)
+			ss << "PV Name: " << failed[i].first << " PQ ERROR: " << failed[i].second << __E__;
+		if(failed.size() > 20)
+			ss << "... and " << failed.size() - 20 << " more" << __E__;
+		__SS_THROW__;
+	}
+}  // end writeArchiveChannelsPipelined()
+
+//========================================================================================================================
+// FNV-1a over every setting that configure() writes
+uint64_t ArchiveChannelConfig::fingerprint() const
+{
+	uint64_t hash = 14695981039346656037ULL;
+	auto     add  = [&hash](const void* data, size_t size) {
+		for(size_t i = 0; i < size; ++i)
+		{
+			hash ^= ((const unsigned char*)data)[i];
+			hash *= 1099511628211ULL;
+		}
+	};
+	auto addString = [&add](const std::string& value) {
+		uint32_t size = value.size();
+		add(&size, sizeof(size));  // so "ab"+"c" differs from "a"+"bc"
+		add(value.data(), value.size());
+	};
+
+	addString(descr);
+	for(int value : {grpID, smplModeID, retentID, prec})
+		add(&value, sizeof(value));
+	for(double value : {smplVal, smplPer, retentVal, lowDispRng, highDispRng, lowWarnLmt, highWarnLmt, lowAlarmLmt, highAlarmLmt})
+		add(&value, sizeof(value));
+	addString(unit);
+	return hash;
+}  // end ArchiveChannelConfig::fingerprint()
+
+//========================================================================================================================
+// Fingerprints of the channels last written for sourceTable. They live in the archive
+//	(ots_channel_fingerprint, created once per pool generation) so they match what the
+//	archive holds. A local file is the fallback for a role that may not create or read
+//	that table; its entries are only trusted for channels the archive still lists, and
+//	if even that cannot be checked, nothing is trusted and every channel is written.
+std::unordered_map<std::string, uint64_t> EpicsInterface::loadChannelFingerprints(PGConnectionPool::Lease& db, const std::string& sourceTable)
+{
+	static const char* CREATE_SQL =
+	    "CREATE TABLE IF NOT EXISTS ots_channel_fingerprint (source_table TEXT NOT NULL, name TEXT NOT NULL, fingerprint INT8 NOT NULL, "
+	    "PRIMARY KEY (source_table, name))";
+	static const char* FINGERPRINTS_SQL = "SELECT name, fingerprint FROM ots_channel_fingerprint WHERE source_table = $1";
+	static const char* CHANNELS_SQL     = "SELECT name FROM channel";
+
+	if(!channelFingerprintsLoaded_ && fingerprintFileName_ != "")
+		readChannelFingerprints();
+	channelFingerprintsLoaded_ = true;
+
+	if(!fingerprintTableProbed_ || fingerprintTableGeneration_ != db.generation())
+	{
+		PGResultPtr res(PQexec(db.conn(), CREATE_SQL), PQclear);
+		fingerprintTableAvailable_ = PQresultStatus(res.get()) == PGRES_COMMAND_OK;
+		if(!fingerprintTableAvailable_)
+			__COUT__ << "configure(): channel fingerprint table not available in the Archiver Database. PQ ERROR: " << PQresultErrorMessage(res.get())
+			         << __E__;
+		fingerprintTableProbed_     = true;
+		fingerprintTableGeneration_ = db.generation();
+	}
+
+	PGResultPtr res(nullptr, PQclear);
+	if(fingerprintTableAvailable_)
+		res = db.statements().exec(db.conn(), "channel_fingerprints", FINGERPRINTS_SQL, {sourceTable});
+	if(!res || PQresultStatus(res.get()) != PGRES_TUPLES_OK)
+	{
+		if(res)
+			__COUT__ << "configure(): channel fingerprints not available from the Archiver Database. PQ ERROR: " << PQresultErrorMessage(res.get())
+			         << __E__;
+
+		// the local copy may be stale: the archive can have been restored or edited since
+		std::unordered_map<std::string, uint64_t> fingerprints;
+		res = db.statements().exec(db.conn(), "channel_names", CHANNELS_SQL, {});
+		if(PQresultStatus(res.get()) != PGRES_TUPLES_OK)
+		{
+			__COUT__ << "configure(): archive channel list not available, writing every channel. PQ ERROR: " << PQresultErrorMessage(res.get()) << __E__;
+			return fingerprints;
+		}
+		const std::unordered_map<std::string, uint64_t>& local = channelFingerprints_[sourceTable];
+		for(int i = 0; i < PQntuples(res.get()); i++)
+		{
+			auto it = local.find(PQgetvalue(res.get(), i, 0));
+			if(it != local.end())
+				fingerprints.insert(*it);
+		}
+		__COUT__ << "configure(): using " << fingerprints.size() << " of " << local.size() << " local channel fingerprints" << __E__;
+		return fingerprints;
+	}
+
+	std::unordered_map<std::string, uint64_t> fingerprints;
+	for(int i = 0; i < PQntuples(res.get()); i++)
+		fingerprints[PQgetvalue(res.get(), i, 0)] = (uint64_t)strtoll(PQgetvalue(res.get(), i, 1), NULL, 10);
+	channelFingerprints_[sourceTable] = fingerprints;
+	return fingerprints;
+}  // end loadChannelFingerprints()
+
+//========================================================================================================================
+// Records what configure() just wrote, in the archive and in the local copy
+void EpicsInterface::saveChannelFingerprints(PGConnectionPool::Lease&                 db,
+                                             const std::string&                       sourceTable,
+                                             const std::vector<ArchiveChannelConfig>& written,
+                                             const std::vector<std::string>&          removed)
+{
+	static const char* UPSERT_SQL =
+	    "INSERT INTO ots_channel_fingerprint (source_table, name, fingerprint) SELECT $1, name, fingerprint "
+	    "FROM unnest($2::TEXT[], $3::INT8[]) AS f(name, fingerprint) ON CONFLICT (source_table, name) DO UPDATE SET fingerprint = EXCLUDED.fingerprint";
+	static const char* DELETE_SQL = "DELETE FROM ots_channel_fingerprint WHERE source_table = $1 AND name = ANY($2::TEXT[])";
+
+	// array literals, e.g. {"a","b\"c"}
+	auto array = [](const std::vector<std::string>& values, bool quote) {
+		std::string literal = "{";
+		for(const std::string& value : values)
+		{
+			if(literal.size() > 1)
+				literal += ',';
+			if(!quote)
+			{
+				literal += value;
+				continue;
+			}
+			literal += '"';
+			for(char ch : value)
+			{
+				if(ch == '"' || ch == '\\')
+					literal += '\\';
+				literal += ch;
+			}
+			literal += '"';
+		}
+		return literal + "}";
+	};
+
+	std::unordered_map<std::string, uint64_t>& fingerprints = channelFingerprints_[sourceTable];
+	std::vector<std::string>                   names, values;
+	for(const ArchiveChannelConfig& channel : written)
+	{
+		fingerprints[channel.name] = channel.fingerprint();
+		names.push_back(channel.name);
+		values.push_back(std::to_string((long long)channel.fingerprint()));
+	}
+	for(const std::string& name : removed)
+		fingerprints.erase(name);
+
+	PGResultPtr res(nullptr, PQclear);
+	if(names.size())
+		res = db.statements().exec(db.conn(), "channel_fingerprints_upsert", UPSERT_SQL, {sourceTable, array(names, true), array(values, false)});
+	if(removed.size() && (!res || PQresultStatus(res.get()) == PGRES_COMMAND_OK))
+		res = db.statements().exec(db.conn(), "channel_fingerprints_delete", DELETE_SQL, {sourceTable, array(removed, true)});
+	if(res && PQresultStatus(res.get()) != PGRES_COMMAND_OK)
+		__COUT__ << "configure(): channel fingerprints not saved to the Archiver Database. PQ ERROR: " << PQresultErrorMessage(res.get()) << __E__;
+
+	if(fingerprintFileName_ != "")
+		writeChannelFingerprints();
+}  // end saveChannelFingerprints()
+
+//========================================================================================================================
+// Local copy of channelFingerprints_: a FINGERPRINT_FILE_HEADER line, then one line per
+//	channel, "<size> <source table> <size> <channel name> <hex fingerprint>". The names
+//	are length-prefixed so that no character in them can break the format.
+static const char* FINGERPRINT_FILE_HEADER = "OTSCFP02";
+
+void EpicsInterface::readChannelFingerprints()
+{
+	std::ifstream file(fingerprintFileName_);
+	std::string   header;
+	if(!std::getline(file, header))
+		return;
+	if(header != FINGERPRINT_FILE_HEADER)
+	{
+		__COUT__ << "configure(): ignoring channel fingerprints " << fingerprintFileName_ << " in an older format" << __E__;
+		return;
+	}
+
+	auto readField = [&file](std::string& field) {
+		size_t size;
+		if(!(file >> size) || file.get() != ' ')
+			return false;
+		field.resize(size);
+		return (bool)file.read(&field[0], size);
+	};
+	std::string        table, name;
+	unsigned long long fingerprint;
+	while(readField(table) && readField(name) && file >> std::hex >> fingerprint >> std::dec)
+		channelFingerprints_[table][name] = fingerprint;
+}  // end readChannelFingerprints()
+
+//========================================================================================================================
+void EpicsInterface::writeChannelFingerprints()
+{
+	std::string   tmpFileName = fingerprintFileName_ + ".tmp";
+	std::ofstream file(tmpFileName, std::ios::trunc);
+	file << FINGERPRINT_FILE_HEADER << "\n";
+	for(const auto& table : channelFingerprints_)
+		for(const auto& fingerprint : table.second)
+			file << table.first.size() << " " << table.first << " " << fingerprint.first.size() << " " << fingerprint.first << " " << std::hex
+			     << fingerprint.second << std::dec << "\n";
+	file.close();
+	if(!file || rename(tmpFileName.c_str(), fingerprintFileName_.c_str()) != 0)
+		__COUT__ << "configure(): failed to write channel fingerprints " << fingerprintFileName_ << ": " << strerror(errno) << __E__;
+}  // end writeChannelFingerprints()
+
 DEFINE_OTS_SLOW_CONTROLS(EpicsInterface)